@@ -47,4 +47,2973 @@ Criar uma mini agenda utilizando:
 * Bloquear duplicados
 * Versão binária do arquivo
 
-*/
\ No newline at end of file
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdarg.h>
+
+#define TAM_NOME 100
+#define TAM_TELEFONE 50
+#define TAM_EMAIL 100
+#define CAP_INICIAL 10
+#define ARQUIVO_PADRAO "agenda.txt"
+#define ARQUIVO_BINARIO "agenda.bin"
+#define ARQUIVO_COMPACTO "agenda.agc"
+#define TAM_CAMINHO 260
+#define DIARIO_MINIMO 64 // operações no .log antes de considerar um checkpoint
+#define TAM_SAIDA (64 * 1024) // bloco da saída em blocos (ver Saida)
+
+// ------------------------------------------------------------
+// ESTRUTURAS
+// ------------------------------------------------------------
+
+typedef struct Contato {
+    char nome[TAM_NOME];
+    char telefone[TAM_TELEFONE];
+    char email[TAM_EMAIL];
+} contato;
+
+typedef struct Agenda Agenda;
+
+// Índice hash (endereçamento aberto com sondagem linear) sobre uma chave de
+// texto de cada contato, devolvida por 'chaveDe'.
+// Cada posição guarda o índice do contato no vetor 'agenda' ou -1 (vazia).
+// O tamanho é sempre potência de 2 e a ocupação fica abaixo de 50%, então
+// uma busca exata visita poucas posições em vez de percorrer todo o vetor.
+typedef struct {
+    int *posicoes;
+    int tam;
+    const char *(*chaveDe)(const Agenda *ag, int i);
+    int ativo;
+} IndiceHash;
+
+// Dicionário de domínios de email: cada domínio distinto (em minúsculas)
+// ganha um id pequeno. Poucos domínios cobrem quase todos os contatos, então
+// uma coluna de ids substitui a comparação de strings nas buscas por domínio.
+typedef struct {
+    char **nomes;   // nomes[id]
+    int qtd;
+    int cap;
+    int *tabela;    // hash dos nomes -> id (-1 = vazia)
+    int tamTabela;
+} DicionarioDominios;
+
+// Qual campo identifica um contato repetido ao adicionar
+typedef enum {
+    DUPLICADOS_PERMITIDOS,
+    DUPLICADOS_POR_NOME,
+    DUPLICADOS_POR_TELEFONE
+} ChaveDuplicados;
+
+// Diário (log) de operações: em vez de regravar o arquivo inteiro a cada
+// salvamento, as inclusões e remoções feitas desde o último salvamento são
+// acrescentadas ao final de "<arquivo>.log".
+typedef struct {
+    char arquivo[TAM_CAMINHO]; // arquivo base do diário ("" = nenhum)
+    char *pendentes;           // operações ainda não gravadas no .log
+    size_t tamPendentes;
+    size_t capPendentes;
+    int opsPendentes;
+    int opsNoLog;              // operações já gravadas no .log
+} Diario;
+
+struct Agenda {
+    contato *agenda; // vetor dinâmico
+    int qtd;         // quantidade de contatos
+    int cap;         // capacidade (começa em 10)
+    IndiceHash indiceNome;
+    IndiceHash indiceTelefone;   // chave: telefone normalizado (ver normalizarTelefone)
+    IndiceHash indiceEmail;      // opcional (desligado por padrão)
+    unsigned long long *telefoneNum; // telefone normalizado de cada contato
+    int *dominioId;                  // id do domínio do email (-1 = sem domínio)
+    DicionarioDominios dominios;
+    ChaveDuplicados chaveDuplicados;
+    unsigned int *chaveNome; // início da chave de cada contato em 'chaves'
+    char *chaves;        // nomes sem acentos e em minúsculas (ver dobrarTexto),
+                         // um depois do outro, cada um terminado em '\0'
+    size_t tamChaves;
+    size_t capChaves;
+    size_t chavesSoltas; // bytes de chaves de contatos já removidos
+    int *ordemNome;  // posições do vetor em ordem alfabética (busca por prefixo)
+    int ordemConsolidados; // tamanho da faixa principal de 'ordemNome'
+    Diario diario;
+};
+
+// ------------------------------------------------------------
+// FUNÇÕES AUXILIARES
+// ------------------------------------------------------------
+
+// Lê uma linha inteira (aceita espaços) e remove o '\n' do final.
+// Retorna 0 em fim de arquivo.
+int lerLinha(const char *prompt, char *buf, int tam) {
+    if (prompt != NULL) {
+        printf("%s", prompt);
+        fflush(stdout);
+    }
+    if (fgets(buf, tam, stdin) == NULL) {
+        buf[0] = '\0';
+        return 0;
+    }
+    size_t n = strcspn(buf, "\r\n");
+    if (buf[n] == '\0' && n == (size_t)tam - 1) {
+        // Linha maior que o buffer: descarta o resto
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF) {}
+    }
+    buf[n] = '\0';
+    return 1;
+}
+
+// Copia uma string limitando ao tamanho do destino. O resto do campo é
+// zerado: os registros vão inteiros para o arquivo binário, e sem isso
+// levariam junto o que sobrou de um contato removido daquela posição.
+void copiarCampo(char *dest, const char *orig, size_t tam) {
+    size_t n = strlen(orig);
+    if (n >= tam) n = tam - 1;
+    memcpy(dest, orig, n);
+    memset(dest + n, 0, tam - n);
+}
+
+// Zera os bytes de um campo depois do seu '\0'.
+void zerarSobra(char *campo, size_t tam) {
+    size_t n = strlen(campo);
+    memset(campo + n, 0, tam - n);
+}
+
+// Hash FNV-1a de 32 bits.
+unsigned int hashTexto(const char *s) {
+    unsigned int h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Letra base de cada caractere U+00C0..U+00FF (UTF-8: 0xC3 seguido de
+// 0x80..0xBF); 0 = manter como está (Æ, ×, ß, ...).
+static const char letraSemAcento[64] = {
+    'a', 'a', 'a', 'a', 'a', 'a', 0,   'c', 'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+    'd', 'n', 'o', 'o', 'o', 'o', 'o', 0,   'o', 'u', 'u', 'u', 'u', 'y', 0,   0,
+    'a', 'a', 'a', 'a', 'a', 'a', 0,   'c', 'e', 'e', 'e', 'e', 'i', 'i', 'i', 'i',
+    'd', 'n', 'o', 'o', 'o', 'o', 'o', 0,   'o', 'u', 'u', 'u', 'u', 'y', 0,   'y'
+};
+
+// Chave de comparação de um texto UTF-8: minúsculas e sem acentos do
+// Latin-1 ("João" -> "joao", "AÇÃO" -> "acao"). Nunca fica maior que a
+// original, então cabe num buffer do mesmo tamanho.
+void dobrarTexto(char *dest, const char *orig, size_t tam) {
+    size_t n = 0;
+    const unsigned char *p = (const unsigned char *)orig;
+    while (*p != '\0' && n < tam - 1) {
+        if (p[0] == 0xC3 && p[1] >= 0x80 && p[1] <= 0xBF && letraSemAcento[p[1] - 0x80] != 0) {
+            dest[n++] = letraSemAcento[p[1] - 0x80];
+            p += 2;
+        } else if (p[0] < 0x80) {
+            dest[n++] = (char)tolower(*p++);
+        } else {
+            dest[n++] = (char)*p++;
+        }
+    }
+    dest[n] = '\0';
+}
+
+// Para onde vão os avisos de erro: a tela, ou (no modo lote) o destino
+// registrado, que os põe na mesma saída dos resultados e na ordem certa.
+static void (*destinoAvisos)(void *ctx, const char *texto) = NULL;
+static void *ctxAvisos = NULL;
+
+void avisar(const char *formato, ...) {
+    char texto[TAM_CAMINHO + 128];
+    va_list args;
+    va_start(args, formato);
+    vsnprintf(texto, sizeof texto, formato, args);
+    va_end(args);
+    if (destinoAvisos != NULL) destinoAvisos(ctxAvisos, texto);
+    else fputs(texto, stdout);
+}
+
+// Relógio de parede em segundos, para taxas de coisas que esperam por
+// disco ou pelo terminal (clock() mede só o tempo de CPU).
+double segundosAgora(void) {
+    struct timespec ts;
+    if (timespec_get(&ts, TIME_UTC) == 0) return (double)clock() / CLOCKS_PER_SEC;
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ------------------------------------------------------------
+// ÍNDICE HASH
+// ------------------------------------------------------------
+
+const char *chaveNomeDe(const Agenda *ag, int i) {
+    return ag->chaves + ag->chaveNome[i];
+}
+
+// Acrescenta a chave do nome do contato 'i' ao fim de 'chaves'. Cada chave
+// ocupa só o seu tamanho mais o '\0', e não TAM_NOME bytes por contato.
+int chaveAcrescentar(Agenda *ag, int i) {
+    if (ag->tamChaves + TAM_NOME > ag->capChaves) {
+        size_t novaCap = ag->capChaves > 0 ? ag->capChaves * 2 : 4096;
+        while (novaCap < ag->tamChaves + TAM_NOME) novaCap *= 2;
+        // As posições são unsigned int: o buffer não passa de UINT_MAX
+        char *novo = novaCap <= UINT_MAX ? realloc(ag->chaves, novaCap) : NULL;
+        if (novo == NULL) {
+            avisar("Erro: falha no realloc.\n");
+            return 0;
+        }
+        ag->chaves = novo;
+        ag->capChaves = novaCap;
+    }
+    char *chave = ag->chaves + ag->tamChaves;
+    dobrarTexto(chave, ag->agenda[i].nome, TAM_NOME);
+    ag->chaveNome[i] = (unsigned int)ag->tamChaves;
+    ag->tamChaves += strlen(chave) + 1;
+    return 1;
+}
+
+// As chaves de contatos removidos ficam no buffer até somarem mais da metade
+// dele; aí as chaves em uso são copiadas para um buffer novo, na ordem do
+// vetor. Como a cópia só acontece depois de tantas remoções quanto o que
+// ela copia, o custo por remoção é O(1) amortizado.
+void chavesCompactar(Agenda *ag) {
+    if (ag->chavesSoltas < 4096 || ag->chavesSoltas <= ag->tamChaves / 2) return;
+
+    size_t cap = ag->tamChaves - ag->chavesSoltas + TAM_NOME;
+    char *novo = malloc(cap);
+    if (novo == NULL) return; // continua com o buffer antigo, que ainda vale
+    size_t tam = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        const char *chave = chaveNomeDe(ag, i);
+        size_t n = strlen(chave) + 1;
+        memcpy(novo + tam, chave, n);
+        ag->chaveNome[i] = (unsigned int)tam;
+        tam += n;
+    }
+    free(ag->chaves);
+    ag->chaves = novo;
+    ag->tamChaves = tam;
+    ag->capChaves = cap;
+    ag->chavesSoltas = 0;
+}
+
+const char *chaveEmailDe(const Agenda *ag, int i) {
+    return ag->agenda[i].email;
+}
+
+void indiceIniciar(IndiceHash *ind, const char *(*chaveDe)(const Agenda *, int), int ativo) {
+    ind->posicoes = NULL;
+    ind->tam = 0;
+    ind->chaveDe = chaveDe;
+    ind->ativo = ativo;
+}
+
+void indiceLiberar(IndiceHash *ind) {
+    free(ind->posicoes);
+    ind->posicoes = NULL;
+    ind->tam = 0;
+}
+
+// Insere a posição 'i' (sem verificar duplicados: valores repetidos são permitidos).
+void indiceInserir(IndiceHash *ind, const Agenda *ag, int i) {
+    unsigned int mascara = (unsigned int)ind->tam - 1;
+    unsigned int p = hashTexto(ind->chaveDe(ag, i)) & mascara;
+    while (ind->posicoes[p] != -1)
+        p = (p + 1) & mascara;
+    ind->posicoes[p] = i;
+}
+
+// Reconstrói um índice do zero, com tamanho >= 2 * qtd.
+int indiceReconstruirCampo(IndiceHash *ind, const Agenda *ag) {
+    int tam = 16;
+    while (tam < ag->qtd * 2) tam *= 2;
+
+    if (tam != ind->tam) {
+        int *novo = malloc((size_t)tam * sizeof(int));
+        if (novo == NULL) {
+            avisar("Erro: falha ao alocar o indice.\n");
+            return 0;
+        }
+        free(ind->posicoes);
+        ind->posicoes = novo;
+        ind->tam = tam;
+    }
+    memset(ind->posicoes, -1, (size_t)tam * sizeof(int));
+
+    for (int i = 0; i < ag->qtd; i++)
+        indiceInserir(ind, ag, i);
+    return 1;
+}
+
+// ------------------------------------------------------------
+// TELEFONES NORMALIZADOS
+// ------------------------------------------------------------
+
+// Converte o telefone num inteiro de 64 bits com só os dígitos, precedidos
+// de um 1 para preservar zeros à esquerda:
+// "(11) 98765-4321" e "11987654321" -> 111987654321.
+// Assim buscas e duplicados comparam inteiros, não strings com pontuação.
+// Retorna 0 se não houver dígitos ou se houver mais de 18.
+unsigned long long normalizarTelefone(const char *telefone) {
+    unsigned long long numero = 1;
+    int digitos = 0;
+    for (const char *p = telefone; *p; p++) {
+        if (*p < '0' || *p > '9') continue;
+        if (++digitos > 18) return 0;
+        numero = numero * 10 + (unsigned long long)(*p - '0');
+    }
+    return digitos > 0 ? numero : 0;
+}
+
+unsigned int hashNumero(unsigned long long n) {
+    return (unsigned int)((n * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// O índice de telefones usa a mesma tabela do IndiceHash, mas a chave é
+// 'telefoneNum[i]'. Telefones sem dígitos não entram no índice.
+void telefoneInserir(Agenda *ag, int i) {
+    IndiceHash *ind = &ag->indiceTelefone;
+    if (!ind->ativo || ag->telefoneNum[i] == 0) return;
+    unsigned int mascara = (unsigned int)ind->tam - 1;
+    unsigned int p = hashNumero(ag->telefoneNum[i]) & mascara;
+    while (ind->posicoes[p] != -1)
+        p = (p + 1) & mascara;
+    ind->posicoes[p] = i;
+}
+
+// Com o índice desligado, percorre a coluna 'telefoneNum' (ainda compara
+// inteiros, mas visita todos os contatos).
+int telefoneBuscarNumero(const Agenda *ag, unsigned long long numero, int *saida, int max) {
+    const IndiceHash *ind = &ag->indiceTelefone;
+    if (numero == 0) return 0;
+    if (!ind->ativo || ind->tam == 0) {
+        int achados = 0;
+        for (int i = 0; i < ag->qtd; i++) {
+            if (ag->telefoneNum[i] == numero) {
+                if (achados < max) saida[achados] = i;
+                achados++;
+            }
+        }
+        return achados;
+    }
+
+    unsigned int mascara = (unsigned int)ind->tam - 1;
+    unsigned int p = hashNumero(numero) & mascara;
+    int achados = 0;
+    while (ind->posicoes[p] != -1) {
+        int i = ind->posicoes[p];
+        if (ag->telefoneNum[i] == numero) {
+            if (achados < max) saida[achados] = i;
+            achados++;
+        }
+        p = (p + 1) & mascara;
+    }
+    return achados;
+}
+
+// Busca reversa: quem tem este telefone (em qualquer formatação).
+int buscarPorTelefone(const Agenda *ag, const char *telefone, int *saida, int max) {
+    return telefoneBuscarNumero(ag, normalizarTelefone(telefone), saida, max);
+}
+
+// ------------------------------------------------------------
+// DOMÍNIOS DE EMAIL
+// ------------------------------------------------------------
+
+// Parte depois do último '@', ou NULL se o email não tiver domínio.
+const char *dominioDe(const char *email) {
+    const char *arroba = strrchr(email, '@');
+    return arroba != NULL && arroba[1] != '\0' ? arroba + 1 : NULL;
+}
+
+void paraMinusculas(char *dest, const char *orig, size_t tam) {
+    size_t n = 0;
+    for (; orig[n] != '\0' && n < tam - 1; n++)
+        dest[n] = (char)tolower((unsigned char)orig[n]);
+    dest[n] = '\0';
+}
+
+void dominiosIniciar(DicionarioDominios *d) {
+    d->nomes = NULL;
+    d->qtd = 0;
+    d->cap = 0;
+    d->tabela = NULL;
+    d->tamTabela = 0;
+}
+
+void dominiosLiberar(DicionarioDominios *d) {
+    for (int id = 0; id < d->qtd; id++)
+        free(d->nomes[id]);
+    free(d->nomes);
+    free(d->tabela);
+    dominiosIniciar(d);
+}
+
+// Id de um domínio já em minúsculas, ou -1 se ele não estiver no dicionário.
+int dominiosProcurar(const DicionarioDominios *d, const char *dominio) {
+    if (d->tamTabela == 0) return -1;
+    unsigned int mascara = (unsigned int)d->tamTabela - 1;
+    unsigned int p = hashTexto(dominio) & mascara;
+    while (d->tabela[p] != -1) {
+        if (strcmp(d->nomes[d->tabela[p]], dominio) == 0) return d->tabela[p];
+        p = (p + 1) & mascara;
+    }
+    return -1;
+}
+
+int dominiosRehash(DicionarioDominios *d, int tam) {
+    int *nova = malloc((size_t)tam * sizeof(int));
+    if (nova == NULL) return 0;
+    memset(nova, -1, (size_t)tam * sizeof(int));
+    unsigned int mascara = (unsigned int)tam - 1;
+    for (int id = 0; id < d->qtd; id++) {
+        unsigned int p = hashTexto(d->nomes[id]) & mascara;
+        while (nova[p] != -1) p = (p + 1) & mascara;
+        nova[p] = id;
+    }
+    free(d->tabela);
+    d->tabela = nova;
+    d->tamTabela = tam;
+    return 1;
+}
+
+// Id do domínio do email, incluindo o domínio no dicionário se for novo.
+// Retorna -1 se o email não tiver domínio (ou faltar memória).
+int dominiosIdDoEmail(DicionarioDominios *d, const char *email) {
+    const char *dominio = dominioDe(email);
+    if (dominio == NULL) return -1;
+
+    char chave[TAM_EMAIL];
+    paraMinusculas(chave, dominio, sizeof chave);
+    int id = dominiosProcurar(d, chave);
+    if (id != -1) return id;
+
+    if (d->qtd == d->cap) {
+        int novaCap = d->cap > 0 ? d->cap * 2 : 16;
+        char **novos = realloc(d->nomes, (size_t)novaCap * sizeof(char *));
+        if (novos == NULL) return -1;
+        d->nomes = novos;
+        d->cap = novaCap;
+    }
+    if ((d->qtd + 1) * 2 > d->tamTabela &&
+        !dominiosRehash(d, d->tamTabela > 0 ? d->tamTabela * 2 : 32)) return -1;
+
+    char *copia = malloc(strlen(chave) + 1);
+    if (copia == NULL) return -1;
+    strcpy(copia, chave);
+    id = d->qtd++;
+    d->nomes[id] = copia;
+
+    unsigned int mascara = (unsigned int)d->tamTabela - 1;
+    unsigned int p = hashTexto(chave) & mascara;
+    while (d->tabela[p] != -1) p = (p + 1) & mascara;
+    d->tabela[p] = id;
+    return id;
+}
+
+// Todos os contatos com email no domínio dado: percorre só a coluna de ids
+// (4 bytes por contato) em vez de comparar os emails.
+int buscarPorDominio(const Agenda *ag, const char *dominio, int *saida, int limite) {
+    char chave[TAM_EMAIL];
+    paraMinusculas(chave, dominio[0] == '@' ? dominio + 1 : dominio, sizeof chave);
+    int id = dominiosProcurar(&ag->dominios, chave);
+    if (id == -1) return 0;
+
+    int n = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        if (ag->dominioId[i] == id) {
+            if (n < limite) saida[n] = i;
+            n++;
+        }
+    }
+    return n;
+}
+
+// Reconstrói só as tabelas hash, a partir das colunas derivadas já
+// calculadas (quando os contatos mudam de posição, mas não de valor).
+int indiceReconstruirTabelas(Agenda *ag) {
+    if (!indiceReconstruirCampo(&ag->indiceNome, ag)) return 0;
+    if (ag->indiceEmail.ativo && !indiceReconstruirCampo(&ag->indiceEmail, ag)) return 0;
+
+    IndiceHash *ind = &ag->indiceTelefone;
+    if (!ind->ativo) {
+        indiceLiberar(ind);
+        return 1;
+    }
+    if (ind->tam != ag->indiceNome.tam) {
+        int *novo = malloc((size_t)ag->indiceNome.tam * sizeof(int));
+        if (novo == NULL) {
+            avisar("Erro: falha ao alocar o indice.\n");
+            return 0;
+        }
+        free(ind->posicoes);
+        ind->posicoes = novo;
+        ind->tam = ag->indiceNome.tam;
+    }
+    memset(ind->posicoes, -1, (size_t)ind->tam * sizeof(int));
+    for (int i = 0; i < ag->qtd; i++)
+        telefoneInserir(ag, i);
+    return 1;
+}
+
+// Recalcula as colunas derivadas (chave do nome, telefone normalizado, id
+// do domínio) de todos os contatos e reconstrói os índices hash.
+int indiceReconstruir(Agenda *ag) {
+    ag->tamChaves = 0;
+    ag->chavesSoltas = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        if (!chaveAcrescentar(ag, i)) return 0;
+        ag->telefoneNum[i] = normalizarTelefone(ag->agenda[i].telefone);
+        ag->dominioId[i] = dominiosIdDoEmail(&ag->dominios, ag->agenda[i].email);
+    }
+    return indiceReconstruirTabelas(ag);
+}
+
+unsigned int indiceHashDe(const IndiceHash *ind, const Agenda *ag, int i) {
+    if (ind->chaveDe == NULL) return hashNumero(ag->telefoneNum[i]); // telefones
+    return hashTexto(ind->chaveDe(ag, i));
+}
+
+// Tira a posição 'i' de uma tabela e desconta 1 das posições maiores, que
+// vão andar uma casa no vetor. Deve ser chamada antes de mover as colunas
+// (as chaves ainda estão nas posições antigas). A vaga aberta é preenchida
+// puxando para trás os elementos seguintes da mesma sequência de sondagem,
+// então as buscas continuam corretas sem marcas de "removido".
+void indiceRemoverPosicao(IndiceHash *ind, const Agenda *ag, int i) {
+    if (ind->tam == 0) return;
+    unsigned int mascara = (unsigned int)ind->tam - 1;
+    unsigned int p = indiceHashDe(ind, ag, i) & mascara;
+    while (ind->posicoes[p] != -1 && ind->posicoes[p] != i)
+        p = (p + 1) & mascara;
+
+    if (ind->posicoes[p] == i) { // telefones sem dígitos não estão na tabela
+        unsigned int vaga = p;
+        for (;;) {
+            p = (p + 1) & mascara;
+            int q = ind->posicoes[p];
+            if (q == -1) break;
+            // 'q' pode ir para a vaga se ela está entre o lugar ideal dele e 'p'
+            unsigned int ideal = indiceHashDe(ind, ag, q) & mascara;
+            if (((p - ideal) & mascara) >= ((p - vaga) & mascara)) {
+                ind->posicoes[vaga] = q;
+                vaga = p;
+            }
+        }
+        ind->posicoes[vaga] = -1;
+    }
+
+    // Sem desvio, para o compilador vetorizar a passada
+    for (int k = 0; k < ind->tam; k++)
+        ind->posicoes[k] -= ind->posicoes[k] > i;
+}
+
+// Busca exata de 'valor' usando o índice. Guarda até 'max' posições em
+// 'saida' e retorna quantas encontrou.
+int indiceBuscarCampo(const IndiceHash *ind, const Agenda *ag, const char *valor,
+                      int *saida, int max) {
+    if (ind->tam == 0) return 0;
+
+    unsigned int mascara = (unsigned int)ind->tam - 1;
+    unsigned int p = hashTexto(valor) & mascara;
+    int achados = 0;
+    while (ind->posicoes[p] != -1) {
+        int i = ind->posicoes[p];
+        if (strcmp(ind->chaveDe(ag, i), valor) == 0) {
+            if (achados < max) saida[achados] = i;
+            achados++;
+        }
+        p = (p + 1) & mascara;
+    }
+    return achados;
+}
+
+// Busca pelo nome ignorando acentos e maiúsculas ("joao" acha "João").
+int indiceBuscar(const Agenda *ag, const char *nome, int *saida, int max) {
+    char chave[TAM_NOME];
+    dobrarTexto(chave, nome, sizeof chave);
+    return indiceBuscarCampo(&ag->indiceNome, ag, chave, saida, max);
+}
+
+// Busca exata pelo email. Usa o índice se estiver ligado; senão percorre
+// todos os contatos.
+int buscarPorEmail(const Agenda *ag, const char *email, int *saida, int max) {
+    if (ag->indiceEmail.ativo)
+        return indiceBuscarCampo(&ag->indiceEmail, ag, email, saida, max);
+    int achados = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        if (strcmp(ag->agenda[i].email, email) == 0) {
+            if (achados < max) saida[achados] = i;
+            achados++;
+        }
+    }
+    return achados;
+}
+
+// ------------------------------------------------------------
+// ÍNDICE ORDENADO (BUSCA POR PREFIXO)
+// ------------------------------------------------------------
+
+// 'ordemNome' guarda as posições do vetor ordenadas pela chave do nome
+// (sem acentos, em minúsculas) em duas faixas, cada uma em ordem:
+// [0, ordemConsolidados) é a faixa principal e [ordemConsolidados, qtd)
+// são as inclusões recentes. Incluir só desloca a faixa recente, que fica
+// pequena (ver ordemLimiteRecentes); quando ela enche, as duas faixas são
+// intercaladas numa passada. Assim cada inclusão custa O(raiz de n)
+// amortizado em vez de deslocar a ordem inteira.
+// Os nomes que começam com um prefixo ficam numa faixa contígua de cada
+// parte, achada com busca binária: a consulta custa O(log n + resultados).
+
+static const Agenda *agendaOrdenacao; // usada pelo comparador do qsort
+
+int compararPosicoesPorNome(const void *a, const void *b) {
+    int i = *(const int *)a, j = *(const int *)b;
+    int r = strcmp(chaveNomeDe(agendaOrdenacao, i), chaveNomeDe(agendaOrdenacao, j));
+    if (r != 0) return r;
+    return (i > j) - (i < j); // desempate estável pela posição
+}
+
+// A mesma comparação, para quem já tem a agenda em mãos.
+int compararPosicoes(const Agenda *ag, int i, int j) {
+    int r = strcmp(chaveNomeDe(ag, i), chaveNomeDe(ag, j));
+    if (r != 0) return r;
+    return (i > j) - (i < j);
+}
+
+void ordemReconstruir(Agenda *ag) {
+    for (int i = 0; i < ag->qtd; i++)
+        ag->ordemNome[i] = i;
+    agendaOrdenacao = ag;
+    qsort(ag->ordemNome, (size_t)ag->qtd, sizeof(int), compararPosicoesPorNome);
+    ag->ordemConsolidados = ag->qtd;
+}
+
+// Primeira posição de 'ordemNome[ini..fim)' cujo nome é >= 'chave'.
+int ordemLimiteInferior(const Agenda *ag, const char *chave, int ini, int fim) {
+    while (ini < fim) {
+        int meio = ini + (fim - ini) / 2;
+        if (strcmp(chaveNomeDe(ag, ag->ordemNome[meio]), chave) < 0)
+            ini = meio + 1;
+        else
+            fim = meio;
+    }
+    return ini;
+}
+
+// Tamanho máximo da faixa recente: a menor potência de 2 (pelo menos 64)
+// cujo quadrado cobre a agenda.
+int ordemLimiteRecentes(int qtd) {
+    int limite = 64;
+    while ((long long)limite * limite < qtd) limite *= 2;
+    return limite;
+}
+
+// Intercala a faixa recente na principal, de trás para frente (a principal
+// só anda para a direita). Cada contato recente acha o seu lugar por busca
+// binária e os trechos da principal entre eles andam com memmove: são
+// O(recentes * log n) comparações de nomes, não uma por contato da agenda.
+// Sem memória para a cópia da faixa recente, reordena tudo com qsort.
+void ordemConsolidar(Agenda *ag) {
+    int m = ag->ordemConsolidados;
+    int n = ag->qtd - m;
+    if (n == 0) return;
+
+    int *recentes = malloc((size_t)n * sizeof(int));
+    if (recentes == NULL) {
+        ordemReconstruir(ag);
+        return;
+    }
+    memcpy(recentes, &ag->ordemNome[m], (size_t)n * sizeof(int));
+    int fimPrincipal = m, k = ag->qtd;
+    for (int b = n - 1; b >= 0; b--) {
+        // Primeira posição da principal (até 'fimPrincipal') depois do recente
+        int ini = 0, fim = fimPrincipal;
+        while (ini < fim) {
+            int meio = ini + (fim - ini) / 2;
+            if (compararPosicoes(ag, ag->ordemNome[meio], recentes[b]) < 0)
+                ini = meio + 1;
+            else
+                fim = meio;
+        }
+        int mover = fimPrincipal - ini;
+        k -= mover;
+        memmove(&ag->ordemNome[k], &ag->ordemNome[ini], (size_t)mover * sizeof(int));
+        ag->ordemNome[--k] = recentes[b];
+        fimPrincipal = ini;
+    }
+    free(recentes);
+    ag->ordemConsolidados = ag->qtd;
+}
+
+// Insere o último contato do vetor na faixa recente (desloca só inteiros).
+// Ele tem a maior posição, então fica depois dos nomes iguais.
+void ordemInserirUltimo(Agenda *ag) {
+    int novo = ag->qtd - 1;
+    int ini = ag->ordemConsolidados, fim = novo;
+    while (ini < fim) {
+        int meio = ini + (fim - ini) / 2;
+        if (compararPosicoes(ag, ag->ordemNome[meio], novo) < 0)
+            ini = meio + 1;
+        else
+            fim = meio;
+    }
+    memmove(&ag->ordemNome[ini + 1], &ag->ordemNome[ini], (size_t)(novo - ini) * sizeof(int));
+    ag->ordemNome[ini] = novo;
+
+    if (ag->qtd - ag->ordemConsolidados > ordemLimiteRecentes(ag->qtd))
+        ordemConsolidar(ag);
+}
+
+// Retira a posição 'i' (já removida do vetor) e corrige as posições seguintes.
+// Custa O(n), como o memmove do vetor que acompanha toda remoção.
+void ordemRemover(Agenda *ag, int i) {
+    int j = 0, consolidados = ag->ordemConsolidados;
+    for (int k = 0; k <= ag->qtd; k++) {
+        int p = ag->ordemNome[k];
+        if (p == i) {
+            if (k < ag->ordemConsolidados) consolidados--;
+            continue;
+        }
+        ag->ordemNome[j++] = p > i ? p - 1 : p;
+    }
+    ag->ordemConsolidados = consolidados;
+}
+
+// Guarda em 'saida' até 'limite' posições (em ordem alfabética) de contatos
+// cujo nome começa com 'prefixo'. Retorna quantas guardou.
+int buscarPorPrefixo(const Agenda *ag, const char *prefixo, int *saida, int limite) {
+    char chave[TAM_NOME];
+    dobrarTexto(chave, prefixo, sizeof chave);
+    size_t tam = strlen(chave);
+    int m = ag->ordemConsolidados;
+    // Um cursor em cada faixa, intercalados como num merge
+    int a = ordemLimiteInferior(ag, chave, 0, m);
+    int b = ordemLimiteInferior(ag, chave, m, ag->qtd);
+    int n = 0;
+    while (n < limite) {
+        int pa = a < m ? ag->ordemNome[a] : -1;
+        int pb = b < ag->qtd ? ag->ordemNome[b] : -1;
+        if (pa != -1 && strncmp(chaveNomeDe(ag, pa), chave, tam) != 0) pa = -1;
+        if (pb != -1 && strncmp(chaveNomeDe(ag, pb), chave, tam) != 0) pb = -1;
+        if (pa == -1 && pb == -1) break;
+        if (pb == -1 || (pa != -1 && compararPosicoes(ag, pa, pb) < 0)) {
+            saida[n++] = pa;
+            a++;
+        } else {
+            saida[n++] = pb;
+            b++;
+        }
+    }
+    return n;
+}
+
+// ------------------------------------------------------------
+// DIÁRIO DE OPERAÇÕES
+// ------------------------------------------------------------
+
+// Formato de cada linha do .log:
+//   +nome;telefone;email   (contato adicionado no fim do vetor)
+//   -indice                (contato removido dessa posição)
+
+// Passa a acompanhar 'caminho' (ou nenhum arquivo, se NULL) com o diário vazio.
+void diarioReiniciar(Diario *d, const char *caminho, int opsNoLog) {
+    d->arquivo[0] = '\0';
+    if (caminho != NULL && strlen(caminho) < TAM_CAMINHO)
+        strcpy(d->arquivo, caminho);
+    d->tamPendentes = 0;
+    d->opsPendentes = 0;
+    d->opsNoLog = opsNoLog;
+}
+
+void diarioLiberar(Diario *d) {
+    free(d->pendentes);
+    d->pendentes = NULL;
+    d->capPendentes = 0;
+    diarioReiniciar(d, NULL, 0);
+}
+
+void diarioCaminhoLog(const char *arquivo, char *dest, size_t tam) {
+    snprintf(dest, tam, "%s.log", arquivo);
+}
+
+// Guarda uma operação para o próximo salvamento. Sem arquivo base ainda não
+// há o que complementar: o primeiro salvamento grava tudo.
+void diarioRegistrar(Diario *d, const char *linha) {
+    if (d->arquivo[0] == '\0') return;
+
+    size_t n = strlen(linha);
+    if (d->tamPendentes + n > d->capPendentes) {
+        size_t novaCap = d->capPendentes > 0 ? d->capPendentes * 2 : 4096;
+        while (novaCap < d->tamPendentes + n) novaCap *= 2;
+        char *novo = realloc(d->pendentes, novaCap);
+        if (novo == NULL) {
+            // Sem memória para o diário: o próximo salvamento regrava tudo
+            diarioReiniciar(d, NULL, 0);
+            return;
+        }
+        d->pendentes = novo;
+        d->capPendentes = novaCap;
+    }
+    memcpy(d->pendentes + d->tamPendentes, linha, n);
+    d->tamPendentes += n;
+    d->opsPendentes++;
+}
+
+void diarioRegistrarInclusao(Diario *d, const contato *c) {
+    char linha[TAM_NOME + TAM_TELEFONE + TAM_EMAIL + 8];
+    snprintf(linha, sizeof linha, "+%s;%s;%s\n", c->nome, c->telefone, c->email);
+    diarioRegistrar(d, linha);
+}
+
+void diarioRegistrarRemocao(Diario *d, int i) {
+    char linha[32];
+    snprintf(linha, sizeof linha, "-%d\n", i);
+    diarioRegistrar(d, linha);
+}
+
+// Acrescenta as operações pendentes ao .log (uma única escrita).
+int diarioGravar(Diario *d) {
+    if (d->opsPendentes == 0) return 1;
+
+    char caminhoLog[TAM_CAMINHO + 8];
+    diarioCaminhoLog(d->arquivo, caminhoLog, sizeof caminhoLog);
+    FILE *f = fopen(caminhoLog, "a");
+    if (f == NULL) return 0;
+    int ok = fwrite(d->pendentes, 1, d->tamPendentes, f) == d->tamPendentes;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) return 0;
+
+    d->opsNoLog += d->opsPendentes;
+    d->tamPendentes = 0;
+    d->opsPendentes = 0;
+    return 1;
+}
+
+// ------------------------------------------------------------
+// OPERAÇÕES DA AGENDA
+// ------------------------------------------------------------
+
+int iniciarAgenda(Agenda *ag) {
+    ag->qtd = 0;
+    ag->ordemConsolidados = 0;
+    ag->cap = CAP_INICIAL;
+    ag->agenda = malloc((size_t)ag->cap * sizeof(contato));
+    ag->ordemNome = malloc((size_t)ag->cap * sizeof(int));
+    ag->telefoneNum = malloc((size_t)ag->cap * sizeof(unsigned long long));
+    ag->dominioId = malloc((size_t)ag->cap * sizeof(int));
+    ag->chaveNome = malloc((size_t)ag->cap * sizeof *ag->chaveNome);
+    ag->chaves = NULL;
+    ag->tamChaves = 0;
+    ag->capChaves = 0;
+    ag->chavesSoltas = 0;
+    if (ag->agenda == NULL || ag->ordemNome == NULL || ag->telefoneNum == NULL ||
+        ag->dominioId == NULL || ag->chaveNome == NULL) {
+        avisar("Erro: falha no malloc.\n");
+        free(ag->agenda);
+        free(ag->ordemNome);
+        free(ag->telefoneNum);
+        free(ag->dominioId);
+        free(ag->chaveNome);
+        return 0;
+    }
+    dominiosIniciar(&ag->dominios);
+    indiceIniciar(&ag->indiceNome, chaveNomeDe, 1);
+    indiceIniciar(&ag->indiceTelefone, NULL, 1); // chave numérica: ver telefoneInserir
+    indiceIniciar(&ag->indiceEmail, chaveEmailDe, 0);
+    ag->chaveDuplicados = DUPLICADOS_PERMITIDOS;
+    ag->diario.pendentes = NULL;
+    ag->diario.capPendentes = 0;
+    diarioReiniciar(&ag->diario, NULL, 0);
+    return indiceReconstruir(ag);
+}
+
+void liberarAgenda(Agenda *ag) {
+    free(ag->agenda);
+    free(ag->ordemNome);
+    free(ag->telefoneNum);
+    free(ag->dominioId);
+    free(ag->chaveNome);
+    free(ag->chaves);
+    ag->agenda = NULL;
+    ag->ordemNome = NULL;
+    ag->telefoneNum = NULL;
+    ag->dominioId = NULL;
+    ag->chaveNome = NULL;
+    ag->chaves = NULL;
+    ag->tamChaves = 0;
+    ag->capChaves = 0;
+    ag->chavesSoltas = 0;
+    dominiosLiberar(&ag->dominios);
+    ag->qtd = 0;
+    ag->ordemConsolidados = 0;
+    ag->cap = 0;
+    indiceLiberar(&ag->indiceNome);
+    indiceLiberar(&ag->indiceTelefone);
+    indiceLiberar(&ag->indiceEmail);
+    diarioLiberar(&ag->diario);
+}
+
+// Ajusta a capacidade para exatamente 'novaCap' contatos (só cresce).
+int reservarCapacidade(Agenda *ag, int novaCap) {
+    if (novaCap <= ag->cap) return 1;
+
+    contato *novo = realloc(ag->agenda, (size_t)novaCap * sizeof(contato));
+    if (novo == NULL) {
+        avisar("Erro: falha no realloc.\n");
+        return 0;
+    }
+    ag->agenda = novo;
+
+    int *novaOrdem = realloc(ag->ordemNome, (size_t)novaCap * sizeof(int));
+    if (novaOrdem == NULL) {
+        avisar("Erro: falha no realloc.\n");
+        return 0;
+    }
+    ag->ordemNome = novaOrdem;
+
+    unsigned long long *novosNum = realloc(ag->telefoneNum, (size_t)novaCap * sizeof(unsigned long long));
+    if (novosNum == NULL) {
+        avisar("Erro: falha no realloc.\n");
+        return 0;
+    }
+    ag->telefoneNum = novosNum;
+
+    int *novosIds = realloc(ag->dominioId, (size_t)novaCap * sizeof(int));
+    if (novosIds == NULL) {
+        avisar("Erro: falha no realloc.\n");
+        return 0;
+    }
+    ag->dominioId = novosIds;
+
+    unsigned int *novasChaves = realloc(ag->chaveNome, (size_t)novaCap * sizeof *ag->chaveNome);
+    if (novasChaves == NULL) {
+        avisar("Erro: falha no realloc.\n");
+        return 0;
+    }
+    ag->chaveNome = novasChaves;
+    ag->cap = novaCap;
+    return 1;
+}
+
+// Garante espaço para pelo menos 'minimo' contatos (dobra a capacidade).
+int garantirCapacidade(Agenda *ag, int minimo) {
+    if (minimo <= ag->cap) return 1;
+
+    int novaCap = ag->cap > 0 ? ag->cap : CAP_INICIAL;
+    while (novaCap < minimo) novaCap *= 2;
+    return reservarCapacidade(ag, novaCap);
+}
+
+// Calcula as colunas derivadas do último contato do vetor e o coloca nos
+// índices hash, mantendo a ocupação abaixo de 50%.
+int indiceInserirUltimo(Agenda *ag) {
+    int i = ag->qtd - 1;
+    if (!chaveAcrescentar(ag, i)) return 0;
+    ag->telefoneNum[i] = normalizarTelefone(ag->agenda[i].telefone);
+    ag->dominioId[i] = dominiosIdDoEmail(&ag->dominios, ag->agenda[i].email);
+
+    // Tabelas cheias: só elas crescem, as colunas dos outros já estão prontas
+    if (ag->qtd * 2 > ag->indiceNome.tam)
+        return indiceReconstruirTabelas(ag);
+    indiceInserir(&ag->indiceNome, ag, i);
+    if (ag->indiceEmail.ativo)
+        indiceInserir(&ag->indiceEmail, ag, i);
+    telefoneInserir(ag, i);
+    return 1;
+}
+
+// Liga ou desliga os índices secundários (telefone e email). Ligar constrói
+// o índice na hora; desligar devolve a memória e as buscas passam a
+// percorrer o vetor.
+int definirIndicesSecundarios(Agenda *ag, int telefone, int email) {
+    ag->indiceTelefone.ativo = telefone;
+    ag->indiceEmail.ativo = email;
+    if (!email) indiceLiberar(&ag->indiceEmail);
+    return indiceReconstruir(ag);
+}
+
+// Define qual campo bloqueia contatos repetidos. O teste de duplicado é uma
+// consulta ao índice hash do campo (O(1)), não uma comparação com todos.
+void definirBloqueioDuplicados(Agenda *ag, ChaveDuplicados chave) {
+    ag->chaveDuplicados = chave;
+}
+
+int ehDuplicado(const Agenda *ag, const char *nome, const char *telefone) {
+    char chave[TAM_NOME];
+    switch (ag->chaveDuplicados) {
+        case DUPLICADOS_POR_NOME:
+            copiarCampo(chave, nome, TAM_NOME); // compara como será gravado
+            return indiceBuscar(ag, chave, NULL, 0) > 0;
+        case DUPLICADOS_POR_TELEFONE:
+            // Mesmo número com outra formatação também é duplicado
+            copiarCampo(chave, telefone, TAM_TELEFONE);
+            return telefoneBuscarNumero(ag, normalizarTelefone(chave), NULL, 0) > 0;
+        default:
+            return 0;
+    }
+}
+
+// Inclui o contato sem avisar do duplicado. Retorna 1 se incluiu, -1 se ele
+// é duplicado e 0 se faltou memória (o teste de duplicado é feito uma vez só).
+int incluirContato(Agenda *ag, const char *nome, const char *telefone, const char *email) {
+    if (ehDuplicado(ag, nome, telefone)) return -1;
+    if (!garantirCapacidade(ag, ag->qtd + 1)) return 0;
+
+    contato *c = &ag->agenda[ag->qtd];
+    copiarCampo(c->nome, nome, TAM_NOME);
+    copiarCampo(c->telefone, telefone, TAM_TELEFONE);
+    copiarCampo(c->email, email, TAM_EMAIL);
+    ag->qtd++;
+    // Primeiro os índices hash, que calculam a chave usada pela ordem
+    if (!indiceInserirUltimo(ag)) return 0;
+    ordemInserirUltimo(ag);
+    diarioRegistrarInclusao(&ag->diario, c);
+    return 1;
+}
+
+int adicionarContato(Agenda *ag, const char *nome, const char *telefone, const char *email) {
+    int r = incluirContato(ag, nome, telefone, email);
+    if (r < 0) avisar("Contato duplicado: nao adicionado.\n");
+    return r > 0;
+}
+
+// ------------------------------------------------------------
+// SAÍDA EM BLOCOS
+// ------------------------------------------------------------
+
+// Formato de cada contato na saída
+typedef enum {
+    SAIDA_TEXTO, // [i] nome | telefone | email
+    SAIDA_CSV,   // nome,telefone,email (o mesmo da importação)
+    SAIDA_JSON   // {"nome":"...","telefone":"...","email":"..."}
+} FormatoSaida;
+
+// Acumula o texto num buffer de TAM_SAIDA bytes e só grava quando ele
+// enche: um fwrite por bloco em vez de um printf (com trava do stdio e
+// interpretação do formato) por contato. Um fwrite desse tamanho passa
+// direto para o sistema, sem copiar de novo no buffer do FILE.
+typedef struct {
+    FILE *destino;
+    FormatoSaida formato;
+    size_t usado;
+    int erro;
+    int contatos; // contatos já escritos (para as vírgulas do JSON)
+    char buf[TAM_SAIDA];
+} Saida;
+
+void saidaIniciar(Saida *s, FILE *destino, FormatoSaida formato) {
+    s->destino = destino;
+    s->formato = formato;
+    s->usado = 0;
+    s->erro = 0;
+    s->contatos = 0;
+}
+
+void saidaDescarregar(Saida *s) {
+    if (s->usado > 0 && fwrite(s->buf, 1, s->usado, s->destino) != s->usado)
+        s->erro = 1;
+    s->usado = 0;
+}
+
+void saidaBytes(Saida *s, const char *texto, size_t n) {
+    if (s->usado + n > sizeof s->buf) {
+        saidaDescarregar(s);
+        if (n > sizeof s->buf) {
+            if (fwrite(texto, 1, n, s->destino) != n) s->erro = 1;
+            return;
+        }
+    }
+    memcpy(s->buf + s->usado, texto, n);
+    s->usado += n;
+}
+
+void saidaTexto(Saida *s, const char *texto) {
+    saidaBytes(s, texto, strlen(texto));
+}
+
+// Pares de dígitos "00".."99": converte dois dígitos por divisão.
+static const char paresDigitos[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void saidaInteiro(Saida *s, long v) {
+    char tmp[24];
+    int n = sizeof tmp;
+    unsigned long u = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+    while (u >= 100) {
+        unsigned long par = (u % 100) * 2;
+        u /= 100;
+        tmp[--n] = paresDigitos[par + 1];
+        tmp[--n] = paresDigitos[par];
+    }
+    if (u >= 10) {
+        tmp[--n] = paresDigitos[u * 2 + 1];
+        tmp[--n] = paresDigitos[u * 2];
+    } else {
+        tmp[--n] = (char)('0' + u);
+    }
+    if (v < 0) tmp[--n] = '-';
+    saidaBytes(s, tmp + n, sizeof tmp - (size_t)n);
+}
+
+// Tamanho de um campo de tamanho fixo: o '\0' está sempre dentro dele.
+size_t tamanhoCampo(const char *campo, size_t tam) {
+    const char *fim = memchr(campo, '\0', tam);
+    return fim != NULL ? (size_t)(fim - campo) : tam;
+}
+
+// Campo CSV: entre aspas (com as aspas internas dobradas) só se tiver
+// vírgula, aspas ou quebra de linha.
+void saidaCampoCSV(Saida *s, const char *campo, size_t n) {
+    size_t k = 0;
+    while (k < n && campo[k] != ',' && campo[k] != '"' && campo[k] != '\n' && campo[k] != '\r')
+        k++;
+    if (k == n) {
+        saidaBytes(s, campo, n);
+        return;
+    }
+    saidaBytes(s, "\"", 1);
+    size_t ini = 0;
+    for (k = 0; k < n; k++) {
+        if (campo[k] == '"') {
+            saidaBytes(s, campo + ini, k - ini + 1);
+            saidaBytes(s, "\"", 1);
+            ini = k + 1;
+        }
+    }
+    saidaBytes(s, campo + ini, n - ini);
+    saidaBytes(s, "\"", 1);
+}
+
+// String JSON: escapa aspas, barra invertida e caracteres de controle;
+// os trechos sem escape são copiados de uma vez.
+void saidaCampoJSON(Saida *s, const char *campo, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    saidaBytes(s, "\"", 1);
+    size_t ini = 0;
+    for (size_t k = 0; k < n; k++) {
+        unsigned char ch = (unsigned char)campo[k];
+        if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+        saidaBytes(s, campo + ini, k - ini);
+        if (ch == '"' || ch == '\\') {
+            char esc[2] = { '\\', (char)ch };
+            saidaBytes(s, esc, 2);
+        } else {
+            char esc[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF] };
+            saidaBytes(s, esc, 6);
+        }
+        ini = k + 1;
+    }
+    saidaBytes(s, campo + ini, n - ini);
+    saidaBytes(s, "\"", 1);
+}
+
+// Grava e devolve se tudo foi escrito sem erro.
+int saidaFechar(Saida *s) {
+    saidaDescarregar(s);
+    return !s->erro;
+}
+
+// Escreve o contato 'i' no formato da saída. Os campos são copiados com
+// memcpy a partir do tamanho já conhecido, sem passar por printf.
+void saidaContato(Saida *s, const Agenda *ag, int i) {
+    const contato *c = &ag->agenda[i];
+    size_t nNome = tamanhoCampo(c->nome, TAM_NOME);
+    size_t nTelefone = tamanhoCampo(c->telefone, TAM_TELEFONE);
+    size_t nEmail = tamanhoCampo(c->email, TAM_EMAIL);
+
+    switch (s->formato) {
+        case SAIDA_CSV:
+            saidaCampoCSV(s, c->nome, nNome);
+            saidaBytes(s, ",", 1);
+            saidaCampoCSV(s, c->telefone, nTelefone);
+            saidaBytes(s, ",", 1);
+            saidaCampoCSV(s, c->email, nEmail);
+            saidaBytes(s, "\n", 1);
+            break;
+        case SAIDA_JSON:
+            saidaTexto(s, s->contatos > 0 ? ",\n  {\"nome\":" : "  {\"nome\":");
+            saidaCampoJSON(s, c->nome, nNome);
+            saidaTexto(s, ",\"telefone\":");
+            saidaCampoJSON(s, c->telefone, nTelefone);
+            saidaTexto(s, ",\"email\":");
+            saidaCampoJSON(s, c->email, nEmail);
+            saidaBytes(s, "}", 1);
+            break;
+        default:
+            saidaBytes(s, "[", 1);
+            saidaInteiro(s, i);
+            saidaBytes(s, "] ", 2);
+            saidaBytes(s, c->nome, nNome);
+            saidaBytes(s, " | ", 3);
+            saidaBytes(s, c->telefone, nTelefone);
+            saidaBytes(s, " | ", 3);
+            saidaBytes(s, c->email, nEmail);
+            saidaBytes(s, "\n", 1);
+    }
+    s->contatos++;
+}
+
+// Cabeçalho e rodapé de uma listagem completa (CSV: linha com os nomes das
+// colunas; JSON: o array em volta dos objetos).
+void saidaAbrirLista(Saida *s) {
+    if (s->formato == SAIDA_CSV) saidaTexto(s, "nome,telefone,email\n");
+    else if (s->formato == SAIDA_JSON) saidaTexto(s, "[\n");
+}
+
+void saidaFecharLista(Saida *s) {
+    if (s->formato == SAIDA_JSON) saidaTexto(s, s->contatos > 0 ? "\n]\n" : "]\n");
+}
+
+// ------------------------------------------------------------
+// LISTAGEM E PAGINAÇÃO
+// ------------------------------------------------------------
+
+// Escreve os contatos das posições [inicio, inicio + limite) e retorna
+// quantos escreveu (0 se 'inicio' já passou do fim).
+int listarPagina(const Agenda *ag, Saida *s, int inicio, int limite) {
+    if (inicio < 0) inicio = 0;
+    int fim = ag->qtd;
+    if (limite >= 0 && limite < fim - inicio) fim = inicio + limite;
+    for (int i = inicio; i < fim; i++)
+        saidaContato(s, ag, i);
+    return fim > inicio ? fim - inicio : 0;
+}
+
+// Cursor para listar aos poucos: guarda onde a última página parou.
+// As posições são as do vetor, então uma remoção entre duas páginas
+// desloca os contatos seguintes uma posição para trás.
+typedef struct {
+    int proximo;
+} CursorListagem;
+
+void cursorIniciar(CursorListagem *cur) {
+    cur->proximo = 0;
+}
+
+int cursorTerminou(const CursorListagem *cur, const Agenda *ag) {
+    return cur->proximo >= ag->qtd;
+}
+
+// Escreve a próxima página de até 'limite' contatos e avança o cursor.
+// Retorna quantos escreveu (0 = fim da agenda).
+int cursorProximaPagina(CursorListagem *cur, const Agenda *ag, Saida *s, int limite) {
+    int n = listarPagina(ag, s, cur->proximo, limite);
+    cur->proximo += n;
+    return n;
+}
+
+void listarContatos(const Agenda *ag) {
+    if (ag->qtd == 0) {
+        printf("Agenda vazia.\n");
+        return;
+    }
+    static Saida s; // 64 KB: fora da pilha
+    saidaIniciar(&s, stdout, SAIDA_TEXTO);
+    listarPagina(ag, &s, 0, -1);
+    saidaFechar(&s);
+}
+
+// Exporta todos os contatos em texto, CSV ou JSON para 'caminho' (ou para
+// a tela, se 'caminho' for vazio). O CSV exportado pode ser importado de
+// volta pela opção de importação (separarCamposCSV tira as aspas que
+// saidaCampoCSV põe).
+int exportarContatos(const Agenda *ag, const char *caminho, FormatoSaida formato) {
+    FILE *f = caminho[0] != '\0' ? fopen(caminho, "wb") : stdout;
+    if (f == NULL) {
+        avisar("Erro: nao foi possivel criar \"%s\".\n", caminho);
+        return 0;
+    }
+    static Saida s;
+    saidaIniciar(&s, f, formato);
+    saidaAbrirLista(&s);
+    listarPagina(ag, &s, 0, -1);
+    saidaFecharLista(&s);
+    int ok = saidaFechar(&s);
+    if (f != stdout && fclose(f) != 0) ok = 0;
+    if (!ok) avisar("Erro: falha ao gravar \"%s\".\n", caminho);
+    return ok;
+}
+
+// Busca exata pelo nome (via índice hash). Retorna quantos encontrou.
+int buscarContatos(const Agenda *ag, const char *nome) {
+    int encontrados[64];
+    int n = indiceBuscar(ag, nome, encontrados, 64);
+    int mostrar = n < 64 ? n : 64;
+
+    for (int k = 0; k < mostrar; k++) {
+        const contato *c = &ag->agenda[encontrados[k]];
+        printf("[%d] %s | %s | %s\n", encontrados[k], c->nome, c->telefone, c->email);
+    }
+    if (n > mostrar)
+        printf("... e mais %d contato(s).\n", n - mostrar);
+    if (n == 0)
+        printf("Nenhum contato com o nome \"%s\".\n", nome);
+    return n;
+}
+
+// Remove o contato da posição 'i' puxando os seguintes para trás.
+int removerContatoPorIndice(Agenda *ag, int i) {
+    if (i < 0 || i >= ag->qtd) {
+        avisar("Indice invalido.\n");
+        return 0;
+    }
+    // As tabelas hash são corrigidas no lugar, enquanto as chaves ainda
+    // estão nas posições antigas; as colunas derivadas andam junto com o
+    // vetor, sem recalcular nada.
+    indiceRemoverPosicao(&ag->indiceNome, ag, i);
+    indiceRemoverPosicao(&ag->indiceTelefone, ag, i);
+    indiceRemoverPosicao(&ag->indiceEmail, ag, i);
+    ag->chavesSoltas += strlen(chaveNomeDe(ag, i)) + 1;
+
+    size_t depois = (size_t)(ag->qtd - i - 1);
+    memmove(&ag->agenda[i], &ag->agenda[i + 1], depois * sizeof(contato));
+    memmove(&ag->chaveNome[i], &ag->chaveNome[i + 1], depois * sizeof *ag->chaveNome);
+    memmove(&ag->telefoneNum[i], &ag->telefoneNum[i + 1], depois * sizeof(unsigned long long));
+    memmove(&ag->dominioId[i], &ag->dominioId[i + 1], depois * sizeof(int));
+    ag->qtd--;
+    chavesCompactar(ag);
+    ordemRemover(ag, i);
+    diarioRegistrarRemocao(&ag->diario, i);
+    return 1;
+}
+
+// Remove de uma vez os contatos das posições em 'indices' (em qualquer ordem,
+// repetidas ou inválidas são ignoradas). Em vez de um memmove por remoção
+// (O(n) cada, quadrático no total), marca as posições e compacta o vetor e os
+// índices numa única passada. Retorna quantos contatos foram removidos.
+int removerVarios(Agenda *ag, const int *indices, int n) {
+    if (ag->qtd == 0) return 0;
+
+    // mapa[i] = nova posição do contato i, ou -1 se ele for removido
+    int *mapa = malloc((size_t)ag->qtd * sizeof(int));
+    if (mapa == NULL) {
+        avisar("Erro: falha no malloc.\n");
+        return 0;
+    }
+    for (int i = 0; i < ag->qtd; i++)
+        mapa[i] = 0;
+    for (int k = 0; k < n; k++)
+        if (indices[k] >= 0 && indices[k] < ag->qtd)
+            mapa[indices[k]] = -1;
+
+    // No diário, remoções do fim para o começo equivalem à remoção em bloco
+    for (int i = ag->qtd - 1; i >= 0; i--)
+        if (mapa[i] == -1) diarioRegistrarRemocao(&ag->diario, i);
+
+    // As colunas derivadas são compactadas junto com o vetor
+    int j = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        if (mapa[i] == -1) {
+            ag->chavesSoltas += strlen(chaveNomeDe(ag, i)) + 1;
+            continue;
+        }
+        if (j != i) {
+            ag->agenda[j] = ag->agenda[i];
+            ag->chaveNome[j] = ag->chaveNome[i];
+            ag->telefoneNum[j] = ag->telefoneNum[i];
+            ag->dominioId[j] = ag->dominioId[i];
+        }
+        mapa[i] = j++;
+    }
+
+    // As duas faixas da ordem continuam válidas: só filtra e renumera
+    int m = 0, consolidados = 0;
+    for (int k = 0; k < ag->qtd; k++) {
+        int novo = mapa[ag->ordemNome[k]];
+        if (novo == -1) continue;
+        ag->ordemNome[m++] = novo;
+        if (k < ag->ordemConsolidados) consolidados++;
+    }
+    ag->ordemConsolidados = consolidados;
+
+    int removidos = ag->qtd - j;
+    ag->qtd = j;
+    free(mapa);
+    chavesCompactar(ag);
+    if (!indiceReconstruirTabelas(ag)) return 0;
+    return removidos;
+}
+
+// Troca cada posição guardada na tabela pela nova posição do contato.
+// As chaves não mudam, então cada entrada continua na mesma vaga.
+void indiceRenumerar(IndiceHash *ind, const int *novaPos) {
+    for (int s = 0; s < ind->tam; s++)
+        if (ind->posicoes[s] != -1)
+            ind->posicoes[s] = novaPos[ind->posicoes[s]];
+}
+
+// Ordena o vetor por nome. A ordem alfabética já está pronta em 'ordemNome'
+// (mantida a cada inclusão), então basta mover cada contato uma única vez
+// para a sua posição final, seguindo os ciclos da permutação no próprio
+// vetor, em vez de ordenar os registros de 250 bytes. As colunas derivadas
+// andam junto e as tabelas hash só têm as posições renumeradas.
+int ordenarPorNome(Agenda *ag) {
+    ordemConsolidar(ag);
+
+    int *novaPos = malloc((size_t)(ag->qtd > 0 ? ag->qtd : 1) * sizeof(int));
+    if (novaPos == NULL) {
+        avisar("Erro: falha no malloc.\n");
+        return 0;
+    }
+    for (int j = 0; j < ag->qtd; j++)
+        novaPos[ag->ordemNome[j]] = j;
+    indiceRenumerar(&ag->indiceNome, novaPos);
+    indiceRenumerar(&ag->indiceTelefone, novaPos);
+    if (ag->indiceEmail.ativo)
+        indiceRenumerar(&ag->indiceEmail, novaPos);
+    free(novaPos);
+
+    for (int ini = 0; ini < ag->qtd; ini++) {
+        if (ag->ordemNome[ini] == ini) continue;
+
+        contato temp = ag->agenda[ini];
+        unsigned int tempChave = ag->chaveNome[ini];
+        unsigned long long tempTelefone = ag->telefoneNum[ini];
+        int tempDominio = ag->dominioId[ini];
+        int j = ini;
+        for (;;) {
+            int origem = ag->ordemNome[j];
+            ag->ordemNome[j] = j; // posição j já está no lugar
+            if (origem == ini) {
+                ag->agenda[j] = temp;
+                ag->chaveNome[j] = tempChave;
+                ag->telefoneNum[j] = tempTelefone;
+                ag->dominioId[j] = tempDominio;
+                break;
+            }
+            ag->agenda[j] = ag->agenda[origem];
+            ag->chaveNome[j] = ag->chaveNome[origem];
+            ag->telefoneNum[j] = ag->telefoneNum[origem];
+            ag->dominioId[j] = ag->dominioId[origem];
+            j = origem;
+        }
+    }
+
+    // Todas as posições mudaram: o diário não serve mais, o próximo
+    // salvamento regrava o arquivo inteiro
+    diarioReiniciar(&ag->diario, NULL, 0);
+    return 1;
+}
+
+// Remove todos os contatos com este nome (sem diferenciar acentos e
+// maiúsculas). Retorna quantos removeu.
+int removerContatosPorNome(Agenda *ag, const char *nome) {
+    int n = indiceBuscar(ag, nome, NULL, 0);
+    if (n == 0) return 0;
+
+    int *indices = malloc((size_t)n * sizeof(int));
+    if (indices == NULL) {
+        avisar("Erro: falha no malloc.\n");
+        return 0;
+    }
+    indiceBuscar(ag, nome, indices, n);
+    int removidos = removerVarios(ag, indices, n);
+    free(indices);
+    return removidos;
+}
+
+// ------------------------------------------------------------
+// ARQUIVOS (TEXTO E BINÁRIO)
+// ------------------------------------------------------------
+
+// Formato binário (versão 1): um cabeçalho fixo seguido dos registros
+// 'contato' exatamente como estão na memória. Carregar é um único fread
+// direto para o vetor, sem interpretar campo a campo.
+#define BINARIO_MAGICO "AGND"
+#define BINARIO_VERSAO 1
+
+typedef struct {
+    char magico[4];
+    unsigned int versao;
+    unsigned int tamRegistro; // sizeof(contato) de quem gravou
+    unsigned int qtd;
+} CabecalhoBinario;
+
+// Formato compactado (versão 1), para agendas grandes: os contatos são
+// gravados em ordem alfabética e cada nome guarda só o que difere do anterior
+// ("Maria da Silva", "Maria da Souza" -> 10 bytes em comum + "ouza").
+// Tamanhos usam varint (7 bits por byte). O arquivo é sempre lido inteiro e
+// em sequência, então só o primeiro nome é gravado completo.
+#define COMPACTO_MAGICO "AGNC"
+#define COMPACTO_VERSAO 1
+
+typedef struct {
+    char magico[4];
+    unsigned int versao;
+    unsigned int qtd;
+} CabecalhoCompacto;
+
+typedef enum {
+    FORMATO_TEXTO,
+    FORMATO_BINARIO,
+    FORMATO_COMPACTO
+} FormatoArquivo;
+
+int terminaCom(const char *texto, const char *sufixo) {
+    size_t n = strlen(texto), m = strlen(sufixo);
+    return n >= m && strcmp(texto + n - m, sufixo) == 0;
+}
+
+// O formato é escolhido pela extensão: ".bin", ".agc" ou texto.
+FormatoArquivo formatoDe(const char *caminho) {
+    if (terminaCom(caminho, ".bin")) return FORMATO_BINARIO;
+    if (terminaCom(caminho, ".agc")) return FORMATO_COMPACTO;
+    return FORMATO_TEXTO;
+}
+
+// Formato texto: uma linha de cabeçalho com a quantidade e depois uma linha
+// por contato, campos separados por ';'.
+int salvarTexto(const Agenda *ag, FILE *f) {
+    fprintf(f, "# agenda %d\n", ag->qtd);
+    for (int i = 0; i < ag->qtd; i++) {
+        fprintf(f, "%s;%s;%s\n", ag->agenda[i].nome,
+                ag->agenda[i].telefone, ag->agenda[i].email);
+    }
+    return !ferror(f);
+}
+
+int salvarBinario(const Agenda *ag, FILE *f) {
+    CabecalhoBinario cab;
+    memcpy(cab.magico, BINARIO_MAGICO, 4);
+    cab.versao = BINARIO_VERSAO;
+    cab.tamRegistro = sizeof(contato);
+    cab.qtd = (unsigned int)ag->qtd;
+
+    if (fwrite(&cab, sizeof cab, 1, f) != 1) return 0;
+    return fwrite(ag->agenda, sizeof(contato), (size_t)ag->qtd, f) == (size_t)ag->qtd;
+}
+
+void gravarVarint(FILE *f, size_t v) {
+    while (v >= 0x80) {
+        fputc((int)(v & 0x7F) | 0x80, f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+void gravarTextoCompacto(FILE *f, const char *texto, size_t n) {
+    gravarVarint(f, n);
+    fwrite(texto, 1, n, f);
+}
+
+int salvarCompacto(const Agenda *ag, FILE *f) {
+    CabecalhoCompacto cab;
+    memcpy(cab.magico, COMPACTO_MAGICO, 4);
+    cab.versao = COMPACTO_VERSAO;
+    cab.qtd = (unsigned int)ag->qtd;
+    if (fwrite(&cab, sizeof cab, 1, f) != 1) return 0;
+
+    // 'ordemNome' já dá a ordem alfabética sem mexer no vetor (salvarEmArquivo
+    // consolida as duas faixas antes)
+    const char *anterior = "";
+    for (int k = 0; k < ag->qtd; k++) {
+        const contato *c = &ag->agenda[ag->ordemNome[k]];
+        size_t comum = 0;
+        while (anterior[comum] != '\0' && anterior[comum] == c->nome[comum]) comum++;
+
+        gravarVarint(f, comum);
+        gravarTextoCompacto(f, c->nome + comum, strlen(c->nome + comum));
+        gravarTextoCompacto(f, c->telefone, strlen(c->telefone));
+        gravarTextoCompacto(f, c->email, strlen(c->email));
+        anterior = c->nome;
+    }
+    return !ferror(f);
+}
+
+// Arquivos terminados em ".bin" usam o formato binário; os demais, texto.
+// Se o arquivo já reflete a agenda até o último salvamento, só as operações
+// novas são acrescentadas ao .log. Quando o .log fica grande em relação à
+// agenda, o arquivo base é regravado inteiro (checkpoint) e o .log apagado.
+// O formato compactado é sempre regravado inteiro: ele reordena os contatos,
+// então as posições do diário não valeriam para ele.
+int salvarEmArquivo(Agenda *ag, const char *caminho) {
+    Diario *d = &ag->diario;
+    FormatoArquivo formato = formatoDe(caminho);
+    if (formato != FORMATO_COMPACTO && strcmp(d->arquivo, caminho) == 0 &&
+        d->opsNoLog + d->opsPendentes <= ag->qtd / 2 + DIARIO_MINIMO) {
+        if (diarioGravar(d)) return 1;
+        avisar("Aviso: falha ao gravar o diario, regravando o arquivo.\n");
+    }
+
+    FILE *f = fopen(caminho, formato == FORMATO_TEXTO ? "w" : "wb");
+    if (f == NULL) {
+        avisar("Erro: nao foi possivel abrir \"%s\".\n", caminho);
+        return 0;
+    }
+    if (formato == FORMATO_COMPACTO) ordemConsolidar(ag);
+    int ok;
+    if (formato == FORMATO_BINARIO) ok = salvarBinario(ag, f);
+    else if (formato == FORMATO_COMPACTO) ok = salvarCompacto(ag, f);
+    else ok = salvarTexto(ag, f);
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) {
+        avisar("Erro: falha ao gravar \"%s\".\n", caminho);
+        diarioReiniciar(d, NULL, 0);
+        return 0;
+    }
+    if (formato == FORMATO_COMPACTO) {
+        diarioReiniciar(d, NULL, 0);
+        return 1;
+    }
+
+    char caminhoLog[TAM_CAMINHO + 8];
+    diarioCaminhoLog(caminho, caminhoLog, sizeof caminhoLog);
+    remove(caminhoLog);
+    diarioReiniciar(d, caminho, 0);
+    return 1;
+}
+
+// Copia 'n' bytes de um trecho (não terminado em '\0') para um campo,
+// zerando o resto como copiarCampo.
+void copiarTrecho(char *dest, const char *orig, size_t n, size_t tam) {
+    if (n >= tam) n = tam - 1;
+    memcpy(dest, orig, n);
+    memset(dest + n, 0, tam - n);
+}
+
+// Separa uma linha "nome<sep>telefone<sep>email" em [ini, fim) direto nos
+// campos de 'c'. Retorna 0 se a linha estiver mal formada.
+int separarCampos(const char *ini, const char *fim, char sep, contato *c) {
+    if (fim > ini && fim[-1] == '\r') fim--;
+
+    const char *sep1 = memchr(ini, sep, (size_t)(fim - ini));
+    if (sep1 == NULL) return 0;
+    const char *sep2 = memchr(sep1 + 1, sep, (size_t)(fim - sep1 - 1));
+    if (sep2 == NULL) return 0;
+
+    copiarTrecho(c->nome, ini, (size_t)(sep1 - ini), TAM_NOME);
+    copiarTrecho(c->telefone, sep1 + 1, (size_t)(sep2 - sep1 - 1), TAM_TELEFONE);
+    copiarTrecho(c->email, sep2 + 1, (size_t)(fim - sep2 - 1), TAM_EMAIL);
+    return 1;
+}
+
+// Acrescenta ao vetor o contato da linha "nome;telefone;email" em [ini, fim),
+// sem atualizar os índices (quem carrega reconstrói no final). Linhas vazias
+// ou mal formadas são ignoradas. Um '#' no começo não é comentário: nomes
+// podem começar com '#' (só o cabeçalho da primeira linha é tratado à parte).
+int carregarLinha(Agenda *ag, const char *ini, const char *fim) {
+    if (ini == fim) return 1;
+    if (!garantirCapacidade(ag, ag->qtd + 1)) return 0;
+    if (separarCampos(ini, fim, ';', &ag->agenda[ag->qtd])) ag->qtd++;
+    return 1;
+}
+
+// Chamada para cada linha [ini, fim) (sem o '\n'); retornar 0 interrompe.
+typedef int (*TratarLinha)(void *ctx, const char *ini, const char *fim);
+
+// Lê o arquivo em blocos grandes e separa as linhas à mão, sem uma chamada
+// de stdio por linha.
+int lerLinhasEmBlocos(FILE *f, TratarLinha tratar, void *ctx) {
+    enum { BLOCO = 1 << 16 };
+    char *buf = malloc(BLOCO);
+    if (buf == NULL) {
+        avisar("Erro: falha no malloc.\n");
+        return 0;
+    }
+
+    size_t usados = 0;
+    int descartando = 0, ok = 1;
+    for (;;) {
+        size_t lidos = fread(buf + usados, 1, BLOCO - usados, f);
+        int ultimo = lidos == 0;
+        usados += lidos;
+
+        char *p = buf, *limite = buf + usados;
+        for (;;) {
+            char *nl = memchr(p, '\n', (size_t)(limite - p));
+            if (nl == NULL) {
+                // Fim do arquivo sem '\n' final: a sobra é a última linha
+                if (ultimo && p < limite) nl = limite;
+                else break;
+            }
+            if (descartando) {
+                descartando = 0;
+            } else if (!tratar(ctx, p, nl)) {
+                ok = 0;
+                break;
+            }
+            p = nl < limite ? nl + 1 : limite;
+        }
+        if (!ok || ultimo) break;
+
+        // Move a linha incompleta para o início e lê o próximo bloco
+        usados = (size_t)(limite - p);
+        if (usados == BLOCO) {
+            // Linha maior que o bloco: não é um contato válido, descarta
+            usados = 0;
+            descartando = 1;
+        }
+        memmove(buf, p, usados);
+    }
+
+    if (ferror(f)) ok = 0;
+    free(buf);
+    return ok;
+}
+
+typedef struct {
+    Agenda *ag;
+    int primeiraLinha;
+} CargaTexto;
+
+int tratarLinhaTexto(void *ctx, const char *ini, const char *fim) {
+    CargaTexto *carga = ctx;
+    if (carga->primeiraLinha) {
+        carga->primeiraLinha = 0;
+        // O cabeçalho "# agenda N" permite reservar a capacidade de uma vez.
+        // Só ele é pulado: em qualquer outra linha, '#' é parte do nome.
+        if (fim - ini > 9 && strncmp(ini, "# agenda ", 9) == 0) {
+            long previstos = strtol(ini + 9, NULL, 10);
+            if (previstos > 0 && previstos < INT_MAX)
+                return reservarCapacidade(carga->ag, (int)previstos);
+            return 1;
+        }
+    }
+    return carregarLinha(carga->ag, ini, fim);
+}
+
+int carregarTexto(Agenda *ag, FILE *f) {
+    CargaTexto carga = { ag, 1 };
+    return lerLinhasEmBlocos(f, tratarLinhaTexto, &carga);
+}
+
+int carregarBinario(Agenda *ag, FILE *f) {
+    CabecalhoBinario cab;
+    if (fread(&cab, sizeof cab, 1, f) != 1 || memcmp(cab.magico, BINARIO_MAGICO, 4) != 0) {
+        avisar("Erro: arquivo binario invalido.\n");
+        return 0;
+    }
+    if (cab.versao != BINARIO_VERSAO || cab.tamRegistro != sizeof(contato)) {
+        avisar("Erro: versao do arquivo binario nao suportada.\n");
+        return 0;
+    }
+    if (cab.qtd > (unsigned int)INT_MAX || !reservarCapacidade(ag, (int)cab.qtd)) return 0;
+
+    // Todos os registros de uma vez, direto para o vetor
+    if (fread(ag->agenda, sizeof(contato), cab.qtd, f) != cab.qtd) {
+        avisar("Erro: arquivo binario truncado.\n");
+        return 0;
+    }
+    ag->qtd = (int)cab.qtd;
+
+    // Não confia no arquivo: garante que toda string termina com '\0' e
+    // zera o que vier depois dele, para não regravar bytes soltos
+    for (int i = 0; i < ag->qtd; i++) {
+        contato *c = &ag->agenda[i];
+        c->nome[TAM_NOME - 1] = '\0';
+        c->telefone[TAM_TELEFONE - 1] = '\0';
+        c->email[TAM_EMAIL - 1] = '\0';
+        zerarSobra(c->nome, TAM_NOME);
+        zerarSobra(c->telefone, TAM_TELEFONE);
+        zerarSobra(c->email, TAM_EMAIL);
+    }
+    return 1;
+}
+
+int lerVarint(const unsigned char **p, const unsigned char *fim, size_t *v) {
+    size_t valor = 0;
+    for (int desloc = 0; *p < fim && desloc < 28; desloc += 7) {
+        unsigned char b = *(*p)++;
+        valor |= (size_t)(b & 0x7F) << desloc;
+        if (!(b & 0x80)) {
+            *v = valor;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Lê um texto (varint + bytes) para 'dest' a partir da posição 'inicio'.
+int lerTextoCompacto(const unsigned char **p, const unsigned char *fim,
+                     char *dest, size_t inicio, size_t tam) {
+    size_t n;
+    if (!lerVarint(p, fim, &n) || n > (size_t)(fim - *p) || inicio + n >= tam) return 0;
+    memcpy(dest + inicio, *p, n);
+    memset(dest + inicio + n, 0, tam - inicio - n);
+    *p += n;
+    return 1;
+}
+
+// Lê o arquivo inteiro para a memória com um fread e decodifica de lá.
+int carregarCompacto(Agenda *ag, FILE *f) {
+    CabecalhoCompacto cab;
+    if (fread(&cab, sizeof cab, 1, f) != 1 || memcmp(cab.magico, COMPACTO_MAGICO, 4) != 0) {
+        avisar("Erro: arquivo compactado invalido.\n");
+        return 0;
+    }
+    if (cab.versao != COMPACTO_VERSAO) {
+        avisar("Erro: versao do arquivo compactado nao suportada.\n");
+        return 0;
+    }
+    if (cab.qtd > (unsigned int)INT_MAX || !reservarCapacidade(ag, (int)cab.qtd)) return 0;
+
+    long inicioDados = ftell(f);
+    if (inicioDados < 0 || fseek(f, 0, SEEK_END) != 0) return 0;
+    long tamDados = ftell(f) - inicioDados;
+    if (tamDados < 0 || fseek(f, inicioDados, SEEK_SET) != 0) return 0;
+
+    unsigned char *dados = malloc(tamDados > 0 ? (size_t)tamDados : 1);
+    if (dados == NULL) {
+        avisar("Erro: falha no malloc.\n");
+        return 0;
+    }
+    int ok = fread(dados, 1, (size_t)tamDados, f) == (size_t)tamDados;
+
+    const unsigned char *p = dados, *fim = dados + tamDados;
+    for (unsigned int k = 0; ok && k < cab.qtd; k++) {
+        contato *c = &ag->agenda[k];
+        size_t comum;
+        if (!lerVarint(&p, fim, &comum) || (k == 0 && comum != 0) ||
+            (comum > 0 && comum > strlen(ag->agenda[k - 1].nome))) {
+            ok = 0;
+            break;
+        }
+        if (comum > 0) memcpy(c->nome, ag->agenda[k - 1].nome, comum);
+        ok = lerTextoCompacto(&p, fim, c->nome, comum, TAM_NOME) &&
+             lerTextoCompacto(&p, fim, c->telefone, 0, TAM_TELEFONE) &&
+             lerTextoCompacto(&p, fim, c->email, 0, TAM_EMAIL);
+    }
+    free(dados);
+
+    if (!ok) {
+        avisar("Erro: arquivo compactado corrompido.\n");
+        return 0;
+    }
+    ag->qtd = (int)cab.qtd;
+    return 1;
+}
+
+// Reaplica as operações de "<caminho>.log" sobre o vetor recém-carregado.
+// Os índices são reconstruídos depois, por carregarDeArquivo.
+// Retorna quantas operações havia no .log (0 se ele não existir) ou -1 se
+// alguma não puder ser aplicada: cada "-indice" depende de todas as
+// operações anteriores, então pular uma levaria a remover o contato errado.
+// Uma última linha sem '\n' é o que sobra de uma gravação interrompida: ela
+// é descartada e '*cortado' fica 1, para quem carrega forçar um salvamento
+// completo em vez de acrescentar ao .log depois dos bytes parciais.
+int diarioReaplicar(Agenda *ag, const char *caminho, int *cortado) {
+    char caminhoLog[TAM_CAMINHO + 8];
+    diarioCaminhoLog(caminho, caminhoLog, sizeof caminhoLog);
+    FILE *f = fopen(caminhoLog, "r");
+    if (f == NULL) return 0;
+
+    char linha[TAM_NOME + TAM_TELEFONE + TAM_EMAIL + 8];
+    int ops = 0;
+    *cortado = 0;
+    while (fgets(linha, sizeof linha, f) != NULL) {
+        size_t tam = strlen(linha);
+        if (tam == 0 || linha[tam - 1] != '\n') {
+            if (feof(f)) *cortado = 1; // senão, linha longa demais: não veio do diário
+            break;
+        }
+        size_t n = strcspn(linha, "\r\n");
+        if (n == 0) continue;
+
+        // "+nome;telefone;email": sem a regra de comentário do arquivo texto
+        int aplicada = 0;
+        if (linha[0] == '+') {
+            if (!garantirCapacidade(ag, ag->qtd + 1)) break;
+            aplicada = separarCampos(linha + 1, linha + n, ';', &ag->agenda[ag->qtd]);
+            if (aplicada) ag->qtd++;
+        } else if (linha[0] == '-') {
+            char *fimNumero;
+            long i = strtol(linha + 1, &fimNumero, 10);
+            aplicada = fimNumero != linha + 1 && fimNumero == linha + n && i >= 0 && i < ag->qtd;
+            if (aplicada) {
+                memmove(&ag->agenda[i], &ag->agenda[i + 1], (size_t)(ag->qtd - i - 1) * sizeof(contato));
+                ag->qtd--;
+            }
+        }
+        if (!aplicada) break;
+        ops++;
+    }
+    int completo = feof(f) && !ferror(f);
+    fclose(f);
+    if (!completo) {
+        avisar("Erro: diario \"%s\" corrompido na operacao %d.\n", caminhoLog, ops + 1);
+        return -1;
+    }
+    return ops;
+}
+
+// Substitui o conteúdo atual pelo do arquivo (e do seu .log, se existir).
+// O arquivo é carregado numa agenda nova, que só substitui a atual se tudo
+// der certo: um arquivo inválido ou truncado deixa a agenda como estava.
+int carregarDeArquivo(Agenda *ag, const char *caminho) {
+    FormatoArquivo formato = formatoDe(caminho);
+    FILE *f = fopen(caminho, formato == FORMATO_TEXTO ? "r" : "rb");
+    if (f == NULL) {
+        avisar("Erro: nao foi possivel abrir \"%s\".\n", caminho);
+        return 0;
+    }
+
+    Agenda nova;
+    if (!iniciarAgenda(&nova)) {
+        fclose(f);
+        return 0;
+    }
+    // As opções escolhidas continuam valendo para a agenda carregada
+    nova.chaveDuplicados = ag->chaveDuplicados;
+    nova.indiceTelefone.ativo = ag->indiceTelefone.ativo;
+    nova.indiceEmail.ativo = ag->indiceEmail.ativo;
+
+    int ok;
+    if (formato == FORMATO_BINARIO) ok = carregarBinario(&nova, f);
+    else if (formato == FORMATO_COMPACTO) ok = carregarCompacto(&nova, f);
+    else ok = carregarTexto(&nova, f);
+    fclose(f);
+
+    int opsNoLog = 0, cortado = 0;
+    if (ok && formato != FORMATO_COMPACTO) {
+        opsNoLog = diarioReaplicar(&nova, caminho, &cortado);
+        if (opsNoLog < 0) ok = 0;
+    }
+
+    // Um único rebuild no final em vez de um por linha (as chaves dos nomes,
+    // calculadas por indiceReconstruir, vêm antes da ordem)
+    if (ok) ok = indiceReconstruir(&nova);
+    if (!ok) {
+        liberarAgenda(&nova);
+        return 0;
+    }
+    ordemReconstruir(&nova);
+    if (cortado) {
+        avisar("Aviso: ultima operacao do diario incompleta, descartada; "
+               "o proximo salvamento regrava o arquivo.\n");
+        diarioReiniciar(&nova.diario, NULL, 0);
+    } else {
+        diarioReiniciar(&nova.diario, formato == FORMATO_COMPACTO ? NULL : caminho, opsNoLog);
+    }
+
+    liberarAgenda(ag);
+    *ag = nova;
+    return 1;
+}
+
+// ------------------------------------------------------------
+// IMPORTAÇÃO EM MASSA (CSV)
+// ------------------------------------------------------------
+
+typedef struct {
+    Agenda *ag;
+    long linhas;
+    int importados;
+    int duplicados;
+    int invalidos;
+} ImportacaoCSV;
+
+// Lê um campo CSV de [*p, fim) para 'dest'. Um campo entre aspas pode ter
+// vírgulas, e as aspas internas vêm dobradas (RFC 4180), como saidaCampoCSV
+// grava. Deixa *p na vírgula seguinte ou em 'fim'. Retorna 0 se as aspas
+// não fecharem ou vier algo entre a aspa final e a vírgula.
+int lerCampoCSV(const char **p, const char *fim, char *dest, size_t tam) {
+    const char *q = *p;
+    if (q == fim || *q != '"') {
+        const char *virgula = memchr(q, ',', (size_t)(fim - q));
+        if (virgula == NULL) virgula = fim;
+        copiarTrecho(dest, q, (size_t)(virgula - q), tam);
+        *p = virgula;
+        return 1;
+    }
+
+    size_t n = 0;
+    for (q++;; q++) {
+        if (q == fim) return 0; // aspas abertas até o fim da linha
+        if (*q == '"') {
+            if (q + 1 == fim || q[1] != '"') break;
+            q++; // "" dentro das aspas é uma aspa
+        }
+        if (n < tam - 1) dest[n++] = *q;
+    }
+    memset(dest + n, 0, tam - n);
+    q++;
+    if (q != fim && *q != ',') return 0;
+    *p = q;
+    return 1;
+}
+
+// Separa uma linha CSV "nome,telefone,email" em [ini, fim), tirando as
+// aspas dos campos. Retorna 0 se não houver exatamente três campos.
+// Quebras de linha dentro de aspas não são aceitas (a leitura é por linha,
+// e a digitação também não deixa um campo ter quebra de linha).
+int separarCamposCSV(const char *ini, const char *fim, contato *c) {
+    if (fim > ini && fim[-1] == '\r') fim--;
+
+    const char *p = ini;
+    if (!lerCampoCSV(&p, fim, c->nome, TAM_NOME) || p == fim) return 0;
+    p++;
+    if (!lerCampoCSV(&p, fim, c->telefone, TAM_TELEFONE) || p == fim) return 0;
+    p++;
+    return lerCampoCSV(&p, fim, c->email, TAM_EMAIL) && p == fim;
+}
+
+int tratarLinhaCSV(void *ctx, const char *ini, const char *fim) {
+    ImportacaoCSV *imp = ctx;
+    Agenda *ag = imp->ag;
+
+    if (imp->linhas++ == 0 && fim - ini >= 5 && strncmp(ini, "nome,", 5) == 0)
+        return 1; // cabeçalho
+    if (ini == fim || (fim - ini == 1 && *ini == '\r'))
+        return 1;
+
+    if (!garantirCapacidade(ag, ag->qtd + 1)) return 0;
+    contato *c = &ag->agenda[ag->qtd];
+    // ';' é o separador do arquivo texto e do diário: recusado como na
+    // digitação (lerCampo)
+    if (!separarCamposCSV(ini, fim, c) || strchr(c->nome, ';') != NULL ||
+        strchr(c->telefone, ';') != NULL || strchr(c->email, ';') != NULL) {
+        imp->invalidos++;
+        return 1;
+    }
+    if (ehDuplicado(ag, c->nome, c->telefone)) {
+        imp->duplicados++;
+        return 1;
+    }
+    ag->qtd++;
+    imp->importados++;
+
+    // Os índices hash só precisam acompanhar linha a linha quando o bloqueio
+    // de duplicados consulta eles; senão são reconstruídos no final.
+    if (ag->chaveDuplicados != DUPLICADOS_PERMITIDOS)
+        return indiceInserirUltimo(ag);
+    return 1;
+}
+
+// Estima quantas linhas o arquivo tem a partir do tamanho total e do tamanho
+// médio das linhas do primeiro bloco. Volta a leitura para o início.
+long estimarLinhas(FILE *f) {
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long tamanho = ftell(f);
+    rewind(f);
+    if (tamanho <= 0) return 0;
+
+    char amostra[1 << 16];
+    size_t lidos = fread(amostra, 1, sizeof amostra, f);
+    rewind(f);
+
+    long linhas = 0;
+    for (const char *p = amostra; (p = memchr(p, '\n', (size_t)(amostra + lidos - p))) != NULL; p++)
+        linhas++;
+    if (linhas == 0) return 1;
+    return (long)((double)tamanho * linhas / (double)lidos) + 1;
+}
+
+// Acrescenta os contatos de um CSV "nome,telefone,email" (com ou sem linha de
+// cabeçalho, campos com ou sem aspas). A capacidade é reservada uma vez pela estimativa, as
+// linhas vão direto para o vetor e a ordem alfabética e os índices são
+// reconstruídos uma única vez no final. Retorna quantos contatos importou.
+int importarCSV(Agenda *ag, const char *caminho) {
+    FILE *f = fopen(caminho, "rb");
+    if (f == NULL) {
+        avisar("Erro: nao foi possivel abrir \"%s\".\n", caminho);
+        return 0;
+    }
+
+    double inicio = segundosAgora();
+    long estimativa = estimarLinhas(f);
+    if (estimativa > 0 && estimativa < INT_MAX - ag->qtd)
+        reservarCapacidade(ag, ag->qtd + (int)estimativa);
+
+    ImportacaoCSV imp = { ag, 0, 0, 0, 0 };
+    int ok = lerLinhasEmBlocos(f, tratarLinhaCSV, &imp);
+    fclose(f);
+
+    if (!indiceReconstruir(ag)) ok = 0;
+    ordemReconstruir(ag);
+    // Muitas inclusões de uma vez: o próximo salvamento regrava tudo
+    diarioReiniciar(&ag->diario, NULL, 0);
+
+    double segundos = segundosAgora() - inicio;
+    printf("%d contato(s) importado(s), %d duplicado(s), %d linha(s) invalida(s)",
+           imp.importados, imp.duplicados, imp.invalidos);
+    if (segundos > 0)
+        printf(" - %.0f registros/s", imp.importados / segundos);
+    printf("\n");
+    if (!ok) avisar("Erro: importacao interrompida.\n");
+    return imp.importados;
+}
+
+// ------------------------------------------------------------
+// BUSCA POR TRECHO ("contém")
+// ------------------------------------------------------------
+
+// Guarda em 'saida' até 'limite' posições de contatos cujo nome contém
+// 'trecho' (sem diferenciar acentos e maiúsculas) e retorna quantos contatos
+// contêm o trecho no total.
+// O strstr da glibc já é vetorizado (SSE2/AVX2) e escolhe a versão certa
+// para a CPU ao carregar o programa; para nomes curtos ele foi mais rápido
+// que um filtro próprio de primeiro/último byte com memchr.
+int buscarPorTrecho(const Agenda *ag, const char *trecho, int *saida, int limite) {
+    char chave[TAM_NOME];
+    dobrarTexto(chave, trecho, sizeof chave);
+    int n = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        if (strstr(chaveNomeDe(ag, i), chave) != NULL) {
+            if (n < limite) saida[n] = i;
+            n++;
+        }
+    }
+    return n;
+}
+
+// ------------------------------------------------------------
+// BUSCA APROXIMADA (DISTÂNCIA DE EDIÇÃO)
+// ------------------------------------------------------------
+
+// Distância de edição (Levenshtein) entre o padrão e 'texto', calculada com
+// o algoritmo bit-paralelo de Myers/Hyyrö: cada coluna da tabela de
+// programação dinâmica vira poucas operações sobre um inteiro de 64 bits,
+// com um bit por caractere do padrão (até 64). 'peq[c]' tem um bit ligado em
+// cada posição do padrão onde aparece o byte c.
+// Para assim que a distância não puder mais ficar <= 'maximo' e então
+// retorna maximo + 1.
+int distanciaBitParalela(const uint64_t peq[256], size_t m, const char *texto, size_t n, int maximo) {
+    uint64_t ultimo = (uint64_t)1 << (m - 1);
+    uint64_t pv = m == 64 ? ~(uint64_t)0 : (((uint64_t)1 << m) - 1);
+    uint64_t mv = 0;
+    int pontos = (int)m;
+
+    for (size_t j = 0; j < n; j++) {
+        uint64_t eq = peq[(unsigned char)texto[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & ultimo) pontos++;
+        else if (mh & ultimo) pontos--;
+
+        // Cada coluna restante reduz a distância em no máximo 1
+        if (pontos - (int)(n - j - 1) > maximo) return maximo + 1;
+
+        ph = (ph << 1) | 1; // distância global: a linha 0 cresce 1 por coluna
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return pontos;
+}
+
+// Versão com a tabela em duas linhas, para padrões com mais de 64 bytes.
+int distanciaSimples(const char *a, size_t m, const char *b, size_t n, int maximo) {
+    int *ant = malloc((m + 1) * sizeof(int));
+    int *atual = malloc((m + 1) * sizeof(int));
+    if (ant == NULL || atual == NULL) {
+        free(ant);
+        free(atual);
+        return maximo + 1;
+    }
+    for (size_t i = 0; i <= m; i++) ant[i] = (int)i;
+    for (size_t j = 1; j <= n; j++) {
+        atual[0] = (int)j;
+        for (size_t i = 1; i <= m; i++) {
+            int custo = ant[i - 1] + (a[i - 1] != b[j - 1]);
+            int ins = atual[i - 1] + 1, rem = ant[i] + 1;
+            atual[i] = custo < ins ? (custo < rem ? custo : rem) : (ins < rem ? ins : rem);
+        }
+        int *t = ant; ant = atual; atual = t;
+    }
+    int d = ant[m];
+    free(ant);
+    free(atual);
+    return d;
+}
+
+typedef struct {
+    int pos;
+    int distancia;
+} Aproximado;
+
+static const Agenda *agendaAproximados; // usada pelo comparador do qsort
+
+int compararAproximados(const void *a, const void *b) {
+    const Aproximado *x = a, *y = b;
+    if (x->distancia != y->distancia) return x->distancia - y->distancia;
+    return strcmp(chaveNomeDe(agendaAproximados, x->pos), chaveNomeDe(agendaAproximados, y->pos));
+}
+
+// Contatos cujo nome está a no máximo 'maximo' edições de 'texto' (ambos
+// comparados sem acentos e em minúsculas),
+// do mais parecido para o menos. Guarda até 'limite' resultados em 'saida'
+// e retorna quantos guardou. Nomes cujo tamanho difere mais que 'maximo'
+// são descartados sem calcular a distância.
+int buscarAproximado(const Agenda *ag, const char *texto, int maximo, Aproximado *saida, int limite) {
+    char consulta[TAM_NOME];
+    dobrarTexto(consulta, texto, sizeof consulta);
+    size_t m = strlen(consulta);
+    uint64_t peq[256] = { 0 };
+    if (m > 0 && m <= 64)
+        for (size_t i = 0; i < m; i++)
+            peq[(unsigned char)consulta[i]] |= (uint64_t)1 << i;
+
+    Aproximado *achados = NULL;
+    int n = 0, cap = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        const char *nome = chaveNomeDe(ag, i);
+        size_t tam = strlen(nome);
+        if ((tam > m ? tam - m : m - tam) > (size_t)maximo) continue;
+
+        int d;
+        if (m == 0) d = (int)tam;
+        else if (m <= 64) d = distanciaBitParalela(peq, m, nome, tam, maximo);
+        else d = distanciaSimples(consulta, m, nome, tam, maximo);
+        if (d > maximo) continue;
+
+        if (n == cap) {
+            int novaCap = cap > 0 ? cap * 2 : 64;
+            Aproximado *novo = realloc(achados, (size_t)novaCap * sizeof(Aproximado));
+            if (novo == NULL) break;
+            achados = novo;
+            cap = novaCap;
+        }
+        achados[n].pos = i;
+        achados[n].distancia = d;
+        n++;
+    }
+
+    agendaAproximados = ag;
+    qsort(achados, (size_t)n, sizeof(Aproximado), compararAproximados);
+    if (n > limite) n = limite;
+    if (n > 0) memcpy(saida, achados, (size_t)n * sizeof(Aproximado));
+    free(achados);
+    return n;
+}
+
+// ------------------------------------------------------------
+// RELATÓRIO DE MEMÓRIA
+// ------------------------------------------------------------
+
+// Compara a memória reservada pelos campos de tamanho fixo com a que os
+// textos realmente ocupam (incluindo o '\0'), além do custo dos índices.
+void relatorioMemoria(const Agenda *ag) {
+    size_t usadoTexto = 0;
+    for (int i = 0; i < ag->qtd; i++) {
+        usadoTexto += strlen(ag->agenda[i].nome) + 1;
+        usadoTexto += strlen(ag->agenda[i].telefone) + 1;
+        usadoTexto += strlen(ag->agenda[i].email) + 1;
+    }
+    size_t registros = (size_t)ag->qtd * sizeof(contato);
+    size_t reservado = (size_t)ag->cap * sizeof(contato);
+    // Cada índice: a tabela hash mais a coluna derivada que ele consulta
+    size_t indiceNome = (size_t)ag->indiceNome.tam * sizeof(int) +
+                        (size_t)ag->cap * sizeof *ag->chaveNome + ag->capChaves;
+    size_t indiceTelefone = (size_t)ag->indiceTelefone.tam * sizeof(int) +
+                            (size_t)ag->cap * sizeof(unsigned long long);
+    size_t indiceEmail = (size_t)ag->indiceEmail.tam * sizeof(int);
+    size_t ordem = (size_t)ag->cap * sizeof(int);
+    size_t dicionario = (size_t)ag->dominios.cap * sizeof(char *) +
+                        (size_t)ag->dominios.tamTabela * sizeof(int) +
+                        (size_t)ag->cap * sizeof(int); // coluna dominioId
+    for (int id = 0; id < ag->dominios.qtd; id++)
+        dicionario += strlen(ag->dominios.nomes[id]) + 1;
+
+    printf("Contatos: %d (capacidade %d)\n", ag->qtd, ag->cap);
+    printf("Vetor reservado: %zu bytes (%zu por contato)\n", reservado, sizeof(contato));
+    printf("Registros em uso: %zu bytes\n", registros);
+    printf("Texto efetivo: %zu bytes", usadoTexto);
+    if (ag->qtd > 0)
+        printf(" (media de %.1f por contato, %.1f%% dos registros)",
+               (double)usadoTexto / ag->qtd, 100.0 * (double)usadoTexto / (double)registros);
+    printf("\n");
+    printf("Indice de nomes: %zu bytes (chaves: %zu usados, %zu de removidos, %zu reservados)\n",
+           indiceNome, ag->tamChaves - ag->chavesSoltas, ag->chavesSoltas, ag->capChaves);
+    if (ag->indiceTelefone.ativo)
+        printf("Indice de telefones: %zu bytes\n", indiceTelefone);
+    else
+        printf("Indice de telefones: desligado (coluna de numeros: %zu bytes)\n",
+               (size_t)ag->cap * sizeof(unsigned long long));
+    if (ag->indiceEmail.ativo)
+        printf("Indice de emails: %zu bytes\n", indiceEmail);
+    else
+        printf("Indice de emails: desligado\n");
+    printf("Ordem alfabetica: %zu bytes\n", ordem);
+    if (ag->qtd > 0)
+        printf("Indices por contato: %.1f bytes\n",
+               (double)(indiceNome + (ag->indiceTelefone.ativo ? indiceTelefone : 0) +
+                        indiceEmail + ordem) / ag->qtd);
+    printf("Dominios de email: %d (%zu bytes)\n", ag->dominios.qtd, dicionario);
+}
+
+// ------------------------------------------------------------
+// MODO EM LOTE (./agenda --lote ARQUIVO, ou "-" para a entrada padrão)
+// ------------------------------------------------------------
+
+// Cada linha é um comando: o número da opção do menu e os argumentos
+// separados por ';' (o mesmo separador do arquivo texto).
+//   1;nome;telefone;email   adicionar
+//   2                       listar
+//   3;nome                  buscar por nome
+//   4;indice                remover por índice
+//   5[;arquivo]             salvar (padrão: agenda.txt)
+//   6[;arquivo]             carregar
+//   7                       parar
+//   8;prefixo   13;nome   19;telefone   22;email
+// Linhas vazias e comentários ('#') são ignorados. Os comandos são lidos
+// em blocos e não há prompts: só resultados e erros vão para a saída, por
+// um único buffer (Saida).
+
+typedef struct {
+    Agenda *ag;
+    Saida *saida;
+    long linha;
+    long operacoes;
+    long erros;
+    int parar;
+} Lote;
+
+void loteErro(Lote *l, const char *msg) {
+    saidaTexto(l->saida, "linha ");
+    saidaInteiro(l->saida, l->linha);
+    saidaTexto(l->saida, ": ");
+    saidaTexto(l->saida, msg);
+    saidaBytes(l->saida, "\n", 1);
+    l->erros++;
+}
+
+// Separa "nome;telefone;email" com as mesmas regras da digitação (lerCampo):
+// três campos, nenhum vazio e nenhum com ';'. Um campo que não cabe é
+// recusado em vez de cortado. Retorna a mensagem de erro, ou NULL.
+const char *loteSepararContato(const char *ini, const char *fim, contato *c) {
+    char *campos[3] = { c->nome, c->telefone, c->email };
+    size_t tamanhos[3] = { TAM_NOME, TAM_TELEFONE, TAM_EMAIL };
+    const char *p = ini;
+    for (int k = 0; k < 3; k++) {
+        const char *sep = memchr(p, ';', (size_t)(fim - p));
+        if (sep == NULL) sep = fim;
+        if (k < 2 && sep == fim) return "esperado 1;nome;telefone;email";
+        if (k == 2 && sep != fim) return "campo com ';'";
+        if (sep == p) return "campo vazio";
+        if ((size_t)(sep - p) >= tamanhos[k]) return "campo longo demais";
+        copiarTrecho(campos[k], p, (size_t)(sep - p), tamanhos[k]);
+        p = sep + 1;
+    }
+    return NULL;
+}
+
+// Avisos de erro das funções da agenda durante o lote: vão para a saída
+// dos resultados, com o número da linha, como os erros do próprio lote.
+void loteAviso(void *ctx, const char *texto) {
+    Lote *l = ctx;
+    saidaTexto(l->saida, "linha ");
+    saidaInteiro(l->saida, l->linha);
+    saidaTexto(l->saida, ": ");
+    saidaTexto(l->saida, texto);
+}
+
+// 'n' é o total encontrado; só os 'guardados' primeiros estão em 'pos'.
+void loteResultados(Lote *l, const int *pos, int n, int guardados) {
+    int mostrar = n < guardados ? n : guardados;
+    for (int k = 0; k < mostrar; k++)
+        saidaContato(l->saida, l->ag, pos[k]);
+    if (n > mostrar) {
+        saidaTexto(l->saida, "... e mais ");
+        saidaInteiro(l->saida, n - mostrar);
+        saidaTexto(l->saida, " contato(s).\n");
+    }
+    if (n == 0) saidaTexto(l->saida, "Nenhum contato.\n");
+}
+
+int tratarComandoLote(void *ctx, const char *ini, const char *fim) {
+    Lote *l = ctx;
+    Agenda *ag = l->ag;
+    l->linha++;
+    if (fim > ini && fim[-1] == '\r') fim--;
+    if (ini == fim || *ini == '#') return 1;
+
+    // Número do comando e, depois do primeiro ';', os argumentos
+    int comando = 0;
+    const char *p = ini;
+    while (p < fim && *p >= '0' && *p <= '9' && comando < 1000)
+        comando = comando * 10 + (*p++ - '0');
+    if (p == ini || (p < fim && *p != ';')) {
+        loteErro(l, "comando invalido");
+        return 1;
+    }
+    const char *args = p < fim ? p + 1 : fim;
+    char arg[TAM_CAMINHO];
+    copiarTrecho(arg, args, (size_t)(fim - args), sizeof arg);
+
+    int achados[64];
+    int n;
+    l->operacoes++;
+    switch (comando) {
+        case 1: {
+            contato c;
+            const char *erro = loteSepararContato(args, fim, &c);
+            if (erro != NULL) {
+                loteErro(l, erro);
+            } else {
+                int r = incluirContato(ag, c.nome, c.telefone, c.email);
+                if (r == 0) return 0; // falha de memória
+                if (r < 0) loteErro(l, "contato duplicado");
+            }
+            break;
+        }
+        case 2:
+            if (listarPagina(ag, l->saida, 0, -1) == 0)
+                saidaTexto(l->saida, "Agenda vazia.\n");
+            break;
+        case 3:
+            n = indiceBuscar(ag, arg, achados, 64);
+            loteResultados(l, achados, n, 64);
+            break;
+        case 4: {
+            char *resto;
+            long i = strtol(arg, &resto, 10);
+            if (resto == arg || *resto != '\0' || i < 0 || i >= ag->qtd)
+                loteErro(l, "indice invalido");
+            else if (!removerContatoPorIndice(ag, (int)i))
+                return 0;
+            break;
+        }
+        case 5:
+        case 6: {
+            // Os erros de salvar e carregar chegam por loteAviso
+            const char *caminho = arg[0] != '\0' ? arg : ARQUIVO_PADRAO;
+            int ok = comando == 5 ? salvarEmArquivo(ag, caminho) : carregarDeArquivo(ag, caminho);
+            if (!ok) l->erros++;
+            break;
+        }
+        case 7:
+            l->parar = 1;
+            return 0;
+        case 8:
+            n = buscarPorPrefixo(ag, arg, achados, 64);
+            loteResultados(l, achados, n, 64);
+            break;
+        case 13:
+            n = removerContatosPorNome(ag, arg);
+            if (n == 0) {
+                loteErro(l, "nenhum contato com este nome");
+            } else {
+                saidaInteiro(l->saida, n);
+                saidaTexto(l->saida, " contato(s) removido(s).\n");
+            }
+            break;
+        case 19:
+            n = buscarPorTelefone(ag, arg, achados, 64);
+            loteResultados(l, achados, n, 64);
+            break;
+        case 22:
+            n = buscarPorEmail(ag, arg, achados, 64);
+            loteResultados(l, achados, n, 64);
+            break;
+        default:
+            l->operacoes--;
+            loteErro(l, "comando desconhecido");
+    }
+    return 1;
+}
+
+// Executa os comandos de 'caminho' numa agenda nova. O resumo (operações
+// por segundo) vai para stderr, para não se misturar com os resultados.
+// Retorna 0 se todos os comandos deram certo.
+int executarLote(const char *caminho) {
+    FILE *f = strcmp(caminho, "-") == 0 ? stdin : fopen(caminho, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Erro: nao foi possivel abrir \"%s\".\n", caminho);
+        return 1;
+    }
+    Agenda ag;
+    if (!iniciarAgenda(&ag)) {
+        if (f != stdin) fclose(f);
+        return 1;
+    }
+
+    static Saida saida;
+    saidaIniciar(&saida, stdout, SAIDA_TEXTO);
+    Lote lote = { &ag, &saida, 0, 0, 0, 0 };
+
+    destinoAvisos = loteAviso;
+    ctxAvisos = &lote;
+    double inicio = segundosAgora();
+    int ok = lerLinhasEmBlocos(f, tratarComandoLote, &lote) || lote.parar;
+    double segundos = segundosAgora() - inicio;
+    destinoAvisos = NULL;
+    ctxAvisos = NULL;
+    if (!saidaFechar(&saida)) ok = 0;
+
+    if (f != stdin) fclose(f);
+    liberarAgenda(&ag);
+    fflush(stdout);
+
+    fprintf(stderr, "%ld operacao(oes) em %.3f s", lote.operacoes, segundos);
+    if (segundos > 0)
+        fprintf(stderr, " (%.0f ops/s)", lote.operacoes / segundos);
+    fprintf(stderr, ", %ld erro(s)\n", lote.erros);
+    if (!ok) fprintf(stderr, "Erro: lote interrompido na linha %ld.\n", lote.linha);
+    return ok && lote.erros == 0 ? 0 : 1;
+}
+
+// ------------------------------------------------------------
+// BENCHMARK (./agenda --bench N)
+// ------------------------------------------------------------
+
+// Busca linear, como seria sem o índice (usada só para comparação).
+int buscarLinear(const Agenda *ag, const char *nome) {
+    int n = 0;
+    for (int i = 0; i < ag->qtd; i++)
+        if (strcmp(ag->agenda[i].nome, nome) == 0) n++;
+    return n;
+}
+
+int compararContatosPorNome(const void *a, const void *b) {
+    return strcmp(((const contato *)a)->nome, ((const contato *)b)->nome);
+}
+
+// Tempo para gravar todos os contatos em 'f', com fprintf por contato ou
+// com o formatador em blocos. O JSON do fprintf não escapa os campos, então
+// é uma referência otimista.
+double medirListagem(const Agenda *ag, FILE *f, FormatoSaida formato, int comPrintf) {
+    static Saida saida;
+    clock_t t = clock();
+    if (comPrintf) {
+        for (int i = 0; i < ag->qtd; i++) {
+            const contato *c = &ag->agenda[i];
+            if (formato == SAIDA_CSV)
+                fprintf(f, "%s,%s,%s\n", c->nome, c->telefone, c->email);
+            else if (formato == SAIDA_JSON)
+                fprintf(f, "%s{\"nome\":\"%s\",\"telefone\":\"%s\",\"email\":\"%s\"}",
+                        i > 0 ? ",\n  " : "  ", c->nome, c->telefone, c->email);
+            else
+                fprintf(f, "[%d] %s | %s | %s\n", i, c->nome, c->telefone, c->email);
+        }
+    } else {
+        saidaIniciar(&saida, f, formato);
+        listarPagina(ag, &saida, 0, -1);
+        saidaFechar(&saida);
+    }
+    fflush(f);
+    return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+void benchmarkBusca(int n) {
+    Agenda ag;
+    if (!iniciarAgenda(&ag)) return;
+
+    char nome[TAM_NOME];
+    char telefone[TAM_TELEFONE];
+    char email[TAM_EMAIL];
+    definirIndicesSecundarios(&ag, 1, 1);
+    for (int i = 0; i < n; i++) {
+        snprintf(nome, sizeof nome, "Contato %d", i);
+        // Valores distintos: todos iguais cairiam na mesma cadeia do índice
+        snprintf(telefone, sizeof telefone, "9%08d", i);
+        snprintf(email, sizeof email, "contato%d@exemplo.com", i);
+        if (!adicionarContato(&ag, nome, telefone, email)) {
+            liberarAgenda(&ag);
+            return;
+        }
+    }
+
+    int consultas = 1000;
+    int saida[1];
+    long achadosLinear = 0, achadosHash = 0;
+
+    clock_t t0 = clock();
+    for (int k = 0; k < consultas; k++) {
+        snprintf(nome, sizeof nome, "Contato %d", (int)((k * 7919L) % n));
+        achadosLinear += buscarLinear(&ag, nome);
+    }
+    clock_t t1 = clock();
+    for (int k = 0; k < consultas; k++) {
+        snprintf(nome, sizeof nome, "Contato %d", (int)((k * 7919L) % n));
+        achadosHash += indiceBuscar(&ag, nome, saida, 1);
+    }
+    clock_t t2 = clock();
+
+    double linear = (double)(t1 - t0) / CLOCKS_PER_SEC;
+    double hash = (double)(t2 - t1) / CLOCKS_PER_SEC;
+    printf("%d contatos, %d buscas de cada tipo\n", n, consultas);
+    printf("Busca linear: %.6f s (%ld achados)\n", linear, achadosLinear);
+    printf("Indice hash:  %.6f s (%ld achados)\n", hash, achadosHash);
+
+    // Telefone e email: com o índice secundário e percorrendo o vetor
+    for (int ligado = 1; ligado >= 0; ligado--) {
+        if (!definirIndicesSecundarios(&ag, ligado, ligado)) break;
+        long achadosTelefone = 0, achadosEmail = 0;
+        clock_t t6 = clock();
+        for (int k = 0; k < consultas; k++) {
+            snprintf(telefone, sizeof telefone, "9%08d", (int)((k * 7919L) % n));
+            achadosTelefone += buscarPorTelefone(&ag, telefone, saida, 1);
+        }
+        clock_t t7 = clock();
+        for (int k = 0; k < consultas; k++) {
+            snprintf(email, sizeof email, "contato%d@exemplo.com", (int)((k * 7919L) % n));
+            achadosEmail += buscarPorEmail(&ag, email, saida, 1);
+        }
+        clock_t t8 = clock();
+        printf("Telefone %s: %.6f s (%ld achados)\n", ligado ? "com indice" : "sem indice",
+               (double)(t7 - t6) / CLOCKS_PER_SEC, achadosTelefone);
+        printf("Email %s:    %.6f s (%ld achados)\n", ligado ? "com indice" : "sem indice",
+               (double)(t8 - t7) / CLOCKS_PER_SEC, achadosEmail);
+    }
+
+    int prefixo[10];
+    long achadosPrefixo = 0;
+    clock_t t3 = clock();
+    for (int k = 0; k < consultas; k++) {
+        snprintf(nome, sizeof nome, "Contato %d", (int)((k * 7919L) % n) / 10);
+        achadosPrefixo += buscarPorPrefixo(&ag, nome, prefixo, 10);
+    }
+    clock_t t4 = clock();
+    printf("Prefixo (limite 10): %.6f s (%ld achados)\n",
+           (double)(t4 - t3) / CLOCKS_PER_SEC, achadosPrefixo);
+
+    // "Contém" percorre todos os nomes, então usa menos consultas
+    int consultasTrecho = 20;
+    long achadosTrecho = 0;
+    size_t bytesNomes = 0;
+    for (int i = 0; i < ag.qtd; i++)
+        bytesNomes += strlen(ag.agenda[i].nome);
+    clock_t t5 = clock();
+    for (int k = 0; k < consultasTrecho; k++) {
+        snprintf(nome, sizeof nome, "to %d", (int)((k * 7919L) % n) / 100);
+        achadosTrecho += buscarPorTrecho(&ag, nome, saida, 1);
+    }
+    double trecho = (double)(clock() - t5) / CLOCKS_PER_SEC;
+    printf("Trecho (%d buscas): %.6f s (%ld achados", consultasTrecho, trecho, achadosTrecho);
+    if (trecho > 0)
+        printf(", %.0f MB/s de nomes", (double)bytesNomes * consultasTrecho / trecho / 1e6);
+    printf(")\n");
+
+    Aproximado aproximados[10];
+    long achadosAproximados = 0;
+    clock_t tA = clock();
+    for (int k = 0; k < consultasTrecho; k++) {
+        snprintf(nome, sizeof nome, "Contatu %d", (int)((k * 7919L) % n));
+        achadosAproximados += buscarAproximado(&ag, nome, 2, aproximados, 10);
+    }
+    printf("Aproximada, ate 2 erros (%d buscas): %.6f s (%ld achados)\n", consultasTrecho,
+           (double)(clock() - tA) / CLOCKS_PER_SEC, achadosAproximados);
+
+    // Listagem: fprintf por contato x formatador com saída em blocos, nos
+    // três formatos (para um arquivo temporário, para não medir o terminal)
+    static const char *nomesFormato[] = { "texto", "CSV", "JSON" };
+    FILE *tmp = tmpfile();
+    for (int formato = SAIDA_TEXTO; tmp != NULL && formato <= SAIDA_JSON; formato++) {
+        rewind(tmp);
+        double comPrintf = medirListagem(&ag, tmp, (FormatoSaida)formato, 1);
+        rewind(tmp);
+        double formatador = medirListagem(&ag, tmp, (FormatoSaida)formato, 0);
+        printf("Listar em %-5s: fprintf %.6f s", nomesFormato[formato], comPrintf);
+        if (comPrintf > 0) printf(" (%.0f contatos/s)", ag.qtd / comPrintf);
+        printf(", formatador %.6f s", formatador);
+        if (formatador > 0) printf(" (%.0f contatos/s)", ag.qtd / formatador);
+        printf("\n");
+    }
+    if (tmp != NULL) fclose(tmp);
+
+    // Ordenação: qsort movendo os registros x permutação pela ordem pronta
+    contato *copia = malloc((size_t)ag.qtd * sizeof(contato));
+    if (copia != NULL) {
+        memcpy(copia, ag.agenda, (size_t)ag.qtd * sizeof(contato));
+        clock_t t8 = clock();
+        qsort(copia, (size_t)ag.qtd, sizeof(contato), compararContatosPorNome);
+        clock_t t9 = clock();
+        ordenarPorNome(&ag);
+        clock_t t10 = clock();
+        printf("Ordenar com qsort dos registros: %.6f s\n", (double)(t9 - t8) / CLOCKS_PER_SEC);
+        printf("Ordenar pela ordem ja mantida:   %.6f s%s\n", (double)(t10 - t9) / CLOCKS_PER_SEC,
+               memcmp(copia, ag.agenda, (size_t)ag.qtd * sizeof(contato)) == 0 ? "" : " ERRO: ordens diferentes");
+        free(copia);
+    }
+
+    liberarAgenda(&ag);
+}
+
+// ------------------------------------------------------------
+// MENU
+// ------------------------------------------------------------
+
+int lerOpcao(void) {
+    char buf[32];
+    if (!lerLinha("Opcao: ", buf, sizeof buf)) return 7; // EOF = sair
+    char *fim;
+    long op = strtol(buf, &fim, 10);
+    if (fim == buf || *fim != '\0') return -1;
+    return (int)op;
+}
+
+// Lê um número entre 'minimo' e 'maximo' para '*valor'. Se 'aceitaVazio',
+// Enter deixa '*valor' como está (o padrão); qualquer outra coisa que não
+// seja só um número nesse intervalo é recusada, como em lerOpcao.
+int lerNumero(const char *prompt, int *valor, long minimo, long maximo, int aceitaVazio) {
+    char buf[32];
+    lerLinha(prompt, buf, sizeof buf);
+    if (buf[0] == '\0' && aceitaVazio) return 1;
+    char *fim;
+    long v = strtol(buf, &fim, 10);
+    if (fim == buf || *fim != '\0' || v < minimo || v > maximo) {
+        printf("Valor invalido.\n");
+        return 0;
+    }
+    *valor = (int)v;
+    return 1;
+}
+
+// Campos não podem conter ';' (separador do arquivo texto).
+int lerCampo(const char *prompt, char *buf, int tam) {
+    lerLinha(prompt, buf, tam);
+    if (buf[0] == '\0' || strchr(buf, ';') != NULL) {
+        printf("Valor invalido (vazio ou contem ';').\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+        int n = atoi(argv[2]);
+        if (n <= 0) {
+            printf("Uso: %s --bench N\n", argv[0]);
+            return 1;
+        }
+        benchmarkBusca(n);
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "--lote") == 0)
+        return executarLote(argv[2]);
+
+    Agenda ag;
+    if (!iniciarAgenda(&ag)) return 1;
+
+    int opcao;
+    do {
+        printf("\n=== AGENDA (%d contatos) ===\n", ag.qtd);
+        printf("1. Adicionar contato\n");
+        printf("2. Listar contatos\n");
+        printf("3. Buscar contato por nome\n");
+        printf("4. Remover contato por indice\n");
+        printf("5. Salvar em arquivo\n");
+        printf("6. Carregar do arquivo\n");
+        printf("7. Sair\n");
+        printf("8. Buscar por inicio do nome\n");
+        printf("9. Salvar em arquivo binario\n");
+        printf("10. Carregar do arquivo binario\n");
+        printf("11. Relatorio de memoria\n");
+        printf("12. Buscar nomes que contem um trecho\n");
+        printf("13. Remover contatos por nome\n");
+        printf("14. Ordenar por nome\n");
+        printf("15. Bloquear duplicados\n");
+        printf("16. Importar contatos de CSV\n");
+        printf("17. Salvar em arquivo compactado\n");
+        printf("18. Carregar do arquivo compactado\n");
+        printf("19. Buscar por telefone\n");
+        printf("20. Buscar por dominio de email\n");
+        printf("21. Busca aproximada por nome (tolera erros de digitacao)\n");
+        printf("22. Buscar por email\n");
+        printf("23. Indices de telefone e email\n");
+        printf("24. Listar contatos por paginas\n");
+        printf("25. Exportar contatos (texto, CSV ou JSON)\n");
+
+        opcao = lerOpcao();
+        char nome[TAM_NOME], telefone[TAM_TELEFONE], email[TAM_EMAIL], buf[32];
+
+        switch (opcao) {
+            case 1:
+                if (!lerCampo("Nome: ", nome, sizeof nome)) break;
+                if (!lerCampo("Telefone: ", telefone, sizeof telefone)) break;
+                if (!lerCampo("Email: ", email, sizeof email)) break;
+                if (adicionarContato(&ag, nome, telefone, email))
+                    printf("Contato adicionado.\n");
+                break;
+            case 2:
+                listarContatos(&ag);
+                break;
+            case 3:
+                lerLinha("Nome: ", nome, sizeof nome);
+                buscarContatos(&ag, nome);
+                break;
+            case 4: {
+                int indice;
+                if (lerNumero("Indice: ", &indice, 0, INT_MAX, 0) &&
+                    removerContatoPorIndice(&ag, indice))
+                    printf("Contato removido.\n");
+                break;
+            }
+            case 5:
+                if (salvarEmArquivo(&ag, ARQUIVO_PADRAO))
+                    printf("Agenda salva em \"%s\".\n", ARQUIVO_PADRAO);
+                break;
+            case 6:
+                if (carregarDeArquivo(&ag, ARQUIVO_PADRAO))
+                    printf("%d contato(s) carregado(s).\n", ag.qtd);
+                break;
+            case 7:
+                break;
+            case 8: {
+                int achados[20];
+                lerLinha("Inicio do nome: ", nome, sizeof nome);
+                int n = buscarPorPrefixo(&ag, nome, achados, 20);
+                for (int k = 0; k < n; k++) {
+                    const contato *c = &ag.agenda[achados[k]];
+                    printf("[%d] %s | %s | %s\n", achados[k], c->nome, c->telefone, c->email);
+                }
+                if (n == 0) printf("Nenhum contato encontrado.\n");
+                break;
+            }
+            case 9:
+                if (salvarEmArquivo(&ag, ARQUIVO_BINARIO))
+                    printf("Agenda salva em \"%s\".\n", ARQUIVO_BINARIO);
+                break;
+            case 10:
+                if (carregarDeArquivo(&ag, ARQUIVO_BINARIO))
+                    printf("%d contato(s) carregado(s).\n", ag.qtd);
+                break;
+            case 11:
+                relatorioMemoria(&ag);
+                break;
+            case 12: {
+                int achados[20];
+                lerLinha("Trecho do nome: ", nome, sizeof nome);
+                int n = buscarPorTrecho(&ag, nome, achados, 20);
+                int mostrar = n < 20 ? n : 20;
+                for (int k = 0; k < mostrar; k++) {
+                    const contato *c = &ag.agenda[achados[k]];
+                    printf("[%d] %s | %s | %s\n", achados[k], c->nome, c->telefone, c->email);
+                }
+                if (n > mostrar) printf("... e mais %d contato(s).\n", n - mostrar);
+                if (n == 0) printf("Nenhum contato encontrado.\n");
+                break;
+            }
+            case 13:
+                lerLinha("Nome: ", nome, sizeof nome);
+                printf("%d contato(s) removido(s).\n", removerContatosPorNome(&ag, nome));
+                break;
+            case 14:
+                if (ordenarPorNome(&ag))
+                    printf("Agenda ordenada.\n");
+                break;
+            case 15: {
+                int chave;
+                if (lerNumero("Bloquear por (0 = desligado, 1 = nome, 2 = telefone): ", &chave,
+                              DUPLICADOS_PERMITIDOS, DUPLICADOS_POR_TELEFONE, 0)) {
+                    definirBloqueioDuplicados(&ag, (ChaveDuplicados)chave);
+                    printf("Bloqueio de duplicados atualizado.\n");
+                }
+                break;
+            }
+            case 16: {
+                char caminho[TAM_CAMINHO];
+                lerLinha("Arquivo CSV: ", caminho, sizeof caminho);
+                importarCSV(&ag, caminho);
+                break;
+            }
+            case 17:
+                if (salvarEmArquivo(&ag, ARQUIVO_COMPACTO))
+                    printf("Agenda salva em \"%s\".\n", ARQUIVO_COMPACTO);
+                break;
+            case 18:
+                if (carregarDeArquivo(&ag, ARQUIVO_COMPACTO))
+                    printf("%d contato(s) carregado(s).\n", ag.qtd);
+                break;
+            case 19: {
+                int achados[20];
+                lerLinha("Telefone: ", telefone, sizeof telefone);
+                int n = buscarPorTelefone(&ag, telefone, achados, 20);
+                int mostrar = n < 20 ? n : 20;
+                for (int k = 0; k < mostrar; k++) {
+                    const contato *c = &ag.agenda[achados[k]];
+                    printf("[%d] %s | %s | %s\n", achados[k], c->nome, c->telefone, c->email);
+                }
+                if (n > mostrar) printf("... e mais %d contato(s).\n", n - mostrar);
+                if (n == 0) printf("Nenhum contato com esse telefone.\n");
+                break;
+            }
+            case 20: {
+                int achados[20];
+                lerLinha("Dominio (ex.: gmail.com): ", email, sizeof email);
+                int n = buscarPorDominio(&ag, email, achados, 20);
+                int mostrar = n < 20 ? n : 20;
+                for (int k = 0; k < mostrar; k++) {
+                    const contato *c = &ag.agenda[achados[k]];
+                    printf("[%d] %s | %s | %s\n", achados[k], c->nome, c->telefone, c->email);
+                }
+                if (n > mostrar) printf("... e mais %d contato(s).\n", n - mostrar);
+                if (n == 0) printf("Nenhum contato nesse dominio.\n");
+                break;
+            }
+            case 21: {
+                Aproximado achados[20];
+                lerLinha("Nome: ", nome, sizeof nome);
+                int maximo = 2;
+                if (!lerNumero("Maximo de erros (Enter = 2): ", &maximo, 0, TAM_NOME, 1))
+                    break;
+                int n = buscarAproximado(&ag, nome, maximo, achados, 20);
+                for (int k = 0; k < n; k++) {
+                    const contato *c = &ag.agenda[achados[k].pos];
+                    printf("[%d] %s | %s | %s (%d erro(s))\n", achados[k].pos, c->nome,
+                           c->telefone, c->email, achados[k].distancia);
+                }
+                if (n == 0) printf("Nenhum contato parecido.\n");
+                break;
+            }
+            case 22: {
+                int achados[20];
+                lerLinha("Email: ", email, sizeof email);
+                int n = buscarPorEmail(&ag, email, achados, 20);
+                int mostrar = n < 20 ? n : 20;
+                for (int k = 0; k < mostrar; k++) {
+                    const contato *c = &ag.agenda[achados[k]];
+                    printf("[%d] %s | %s | %s\n", achados[k], c->nome, c->telefone, c->email);
+                }
+                if (n > mostrar) printf("... e mais %d contato(s).\n", n - mostrar);
+                if (n == 0) printf("Nenhum contato com esse email.\n");
+                break;
+            }
+            case 23: {
+                int telefoneLigado, emailLigado;
+                if (!lerNumero("Indice de telefones (0 = desligado, 1 = ligado): ", &telefoneLigado, 0, 1, 0) ||
+                    !lerNumero("Indice de emails (0 = desligado, 1 = ligado): ", &emailLigado, 0, 1, 0))
+                    break;
+                if (definirIndicesSecundarios(&ag, telefoneLigado, emailLigado))
+                    printf("Indices atualizados.\n");
+                break;
+            }
+            case 24: {
+                static Saida saida; // 64 KB: fora da pilha
+                int porPagina = 20;
+                if (!lerNumero("Contatos por pagina (Enter = 20): ", &porPagina, 1, INT_MAX, 1))
+                    break;
+                if (ag.qtd == 0) printf("Agenda vazia.\n");
+                CursorListagem cur;
+                cursorIniciar(&cur);
+                saidaIniciar(&saida, stdout, SAIDA_TEXTO);
+                while (!cursorTerminou(&cur, &ag)) {
+                    cursorProximaPagina(&cur, &ag, &saida, porPagina);
+                    saidaFechar(&saida);
+                    if (cursorTerminou(&cur, &ag)) break;
+                    printf("-- %d de %d --\n", cur.proximo, ag.qtd);
+                    if (!lerLinha("Enter = proxima pagina, q = parar: ", buf, sizeof buf) ||
+                        buf[0] == 'q' || buf[0] == 'Q')
+                        break;
+                }
+                break;
+            }
+            case 25: {
+                char caminho[TAM_CAMINHO];
+                int formato;
+                if (!lerNumero("Formato (0 = texto, 1 = CSV, 2 = JSON): ", &formato,
+                               SAIDA_TEXTO, SAIDA_JSON, 0))
+                    break;
+                lerLinha("Arquivo (Enter = tela): ", caminho, sizeof caminho);
+                if (exportarContatos(&ag, caminho, (FormatoSaida)formato) && caminho[0] != '\0')
+                    printf("%d contato(s) exportado(s) para \"%s\".\n", ag.qtd, caminho);
+                break;
+            }
+            default:
+                printf("Opcao invalida.\n");
+        }
+    } while (opcao != 7);
+
+    liberarAgenda(&ag);
+    printf("Memoria liberada. Ate mais!\n");
+    return 0;
+}